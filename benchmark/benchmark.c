@@ -0,0 +1,700 @@
+/****************************************************************************
+ * benchmark.c
+ * openacousticdevices.info
+ * October 2026
+ *****************************************************************************/
+
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "biquad.h"
+#include "butterworth.h"
+#include "digitalfilter.h"
+
+/* Device constants */
+
+#define INPUT_SAMPLE_RATE                       384000
+#define CORTEX_M4_CLOCK_FREQUENCY               48000000
+
+/* DMA transfer constant */
+
+#define MAXIMUM_SAMPLES_IN_DMA_TRANSFER         1024
+
+/* DC filter constant */
+
+#define DEFAULT_DC_BLOCKING_FREQ                48
+
+/* Band pass filter constants */
+
+#define BAND_PASS_LOWER_FREQ                    10000
+#define BAND_PASS_UPPER_FREQ                    20000
+
+/* Trigger constants */
+
+#define AMPLITUDE_THRESHOLD                     1000
+
+#define GOERTZEL_WINDOW_LENGTH                  512
+#define GOERTZEL_FREQUENCY                      40000
+#define GOERTZEL_PERCENTAGE_THRESHOLD           10.0f
+
+/* Dual gain constant. This is the ratio of the high and low analog gain settings */
+
+#define DUAL_GAIN_SECONDARY_GAIN                (30.0f / 4.33f)
+
+/* Audio configuration filter constants */
+
+#define CONFIG_SAMPLE_RATE                      48000
+#define CONFIG_CARRIER_FREQUENCY                18000
+#define CARRIER_FILTER_CUTOFF_FREQUENCY         1000
+#define AGC_FILTER_CUTOFF_FREQUENCY             1000
+#define CONFIG_SAMPLE_BLOCK_SIZE                16
+
+/* Alias rejection constants */
+
+#define TEST_TONE_AMPLITUDE                     500.0
+#define PASS_BAND_TONE_FREQUENCY                0.25
+#define ALIASED_TONE_FREQUENCY                  0.75
+#define SETTLING_TRANSFERS                      16
+
+/* Benchmark defaults */
+
+#define DEFAULT_BENCHMARK_SECONDS               10
+#define DEFAULT_BENCHMARK_REPEATS               3
+#define DEFAULT_HOST_CLOCK_MHZ                  3000.0f
+#define DEFAULT_HOST_TO_CORTEX_M4_RATIO         4.0f
+
+/* Synthetic input constants */
+
+#define SYNTHETIC_NOISE_AMPLITUDE               8192
+#define SYNTHETIC_DC_OFFSET                     200
+
+/* WAV file constants */
+
+#define PCM_FORMAT                              1
+#define RIFF_ID_LENGTH                          4
+#define BITS_PER_SAMPLE                         16
+
+/* Useful time constants */
+
+#define NANOSECONDS_IN_SECOND                   1000000000.0
+
+/* Useful macros */
+
+#define MIN(a, b)                               ((a) < (b) ? (a) : (b))
+
+#define MAX(a, b)                               ((a) > (b) ? (a) : (b))
+
+/* Benchmark path enumeration */
+
+typedef enum {BM_FILTER, BM_AMPLITUDE_THRESHOLD, BM_GOERTZEL_THRESHOLD, BM_FREQUENCY_TRIGGER, BM_DECIMATION, BM_DUAL_GAIN, BM_EXTENDED} BM_path_t;
+
+typedef struct {
+    char *name;
+    BM_path_t path;
+    DF_filterType_t filterType;
+    uint32_t sampleRateDivider;
+} benchmarkCase_t;
+
+/* Every path through DigitalFilter_applyFilter and DigitalFilter_applyFrequencyTrigger */
+
+static const benchmarkCase_t benchmarkCases[] = {
+    {"Specialised kernel", BM_FILTER, DF_HIGH_PASS_FILTER, 2},
+    {"Specialised kernel", BM_FILTER, DF_HIGH_PASS_FILTER, 3},
+    {"Specialised kernel", BM_FILTER, DF_HIGH_PASS_FILTER, 4},
+    {"Specialised kernel", BM_FILTER, DF_HIGH_PASS_FILTER, 6},
+    {"Specialised kernel", BM_FILTER, DF_HIGH_PASS_FILTER, 8},
+    {"Specialised kernel", BM_FILTER, DF_HIGH_PASS_FILTER, 12},
+    {"Specialised kernel", BM_FILTER, DF_HIGH_PASS_FILTER, 16},
+    {"Specialised kernel", BM_FILTER, DF_HIGH_PASS_FILTER, 24},
+    {"Specialised kernel", BM_FILTER, DF_HIGH_PASS_FILTER, 48},
+    {"Generic kernel", BM_FILTER, DF_HIGH_PASS_FILTER, 5},
+    {"Specialised kernel", BM_FILTER, DF_BAND_PASS_FILTER, 2},
+    {"Specialised kernel", BM_FILTER, DF_BAND_PASS_FILTER, 8},
+    {"Amplitude threshold kernel", BM_AMPLITUDE_THRESHOLD, DF_HIGH_PASS_FILTER, 1},
+    {"Amplitude threshold kernel", BM_AMPLITUDE_THRESHOLD, DF_BAND_PASS_FILTER, 1},
+    {"fastFilterWithGoertzelFilterThreshold", BM_GOERTZEL_THRESHOLD, DF_HIGH_PASS_FILTER, 1},
+    {"fastFilterWithGoertzelFilterThreshold", BM_GOERTZEL_THRESHOLD, DF_BAND_PASS_FILTER, 1},
+    {"DigitalFilter_applyFrequencyTrigger", BM_FREQUENCY_TRIGGER, DF_HIGH_PASS_FILTER, 1},
+    {"CIC and half-band decimator", BM_DECIMATION, DF_HIGH_PASS_FILTER, 4},
+    {"CIC and half-band decimator", BM_DECIMATION, DF_HIGH_PASS_FILTER, 8},
+    {"CIC and half-band decimator", BM_DECIMATION, DF_HIGH_PASS_FILTER, 12},
+    {"CIC and half-band decimator", BM_DECIMATION, DF_HIGH_PASS_FILTER, 24},
+    {"CIC and half-band decimator", BM_DECIMATION, DF_HIGH_PASS_FILTER, 48},
+    {"CIC and half-band decimator", BM_DECIMATION, DF_BAND_PASS_FILTER, 8},
+    {"Dual gain kernel", BM_DUAL_GAIN, DF_HIGH_PASS_FILTER, 2},
+    {"Dual gain kernel", BM_DUAL_GAIN, DF_HIGH_PASS_FILTER, 8},
+    {"Dual gain kernel", BM_DUAL_GAIN, DF_HIGH_PASS_FILTER, 48},
+    {"Dual gain generic kernel", BM_DUAL_GAIN, DF_HIGH_PASS_FILTER, 5},
+    {"24-bit kernel", BM_EXTENDED, DF_HIGH_PASS_FILTER, 2},
+    {"24-bit kernel", BM_EXTENDED, DF_HIGH_PASS_FILTER, 8},
+    {"24-bit kernel", BM_EXTENDED, DF_HIGH_PASS_FILTER, 48},
+    {"24-bit generic kernel", BM_EXTENDED, DF_HIGH_PASS_FILTER, 5}
+};
+
+/* Sample rate dividers checked for alias rejection */
+
+static const uint32_t aliasSampleRateDividers[] = {4, 6, 8, 12, 24, 48};
+
+#define NUMBER_OF_ALIAS_DIVIDERS                (sizeof(aliasSampleRateDividers) / sizeof(uint32_t))
+
+#define NUMBER_OF_BENCHMARK_CASES               (sizeof(benchmarkCases) / sizeof(benchmarkCase_t))
+
+/* Input and output buffers */
+
+static int16_t *input;
+
+static int16_t *output;
+
+static int16_t *reference;
+
+static uint32_t numberOfInputSamples;
+
+/* Functions to generate or load the input samples */
+
+static void generateSyntheticNoise(uint32_t numberOfSamples) {
+
+    uint32_t state = 0x12345678;
+
+    for (uint32_t i = 0; i < numberOfSamples; i += 1) {
+
+        /* Xorshift generator so every run sees the same samples */
+
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        input[i] = (int16_t)((int32_t)(state % (2 * SYNTHETIC_NOISE_AMPLITUDE)) - SYNTHETIC_NOISE_AMPLITUDE + SYNTHETIC_DC_OFFSET);
+
+    }
+
+}
+
+static bool loadWavFile(char *filename, uint32_t numberOfSamples) {
+
+    FILE *fp = fopen(filename, "rb");
+
+    if (fp == NULL) return false;
+
+    char id[RIFF_ID_LENGTH];
+
+    uint32_t size;
+
+    if (fread(id, 1, RIFF_ID_LENGTH, fp) != RIFF_ID_LENGTH || memcmp(id, "RIFF", RIFF_ID_LENGTH)) goto error;
+
+    if (fread(&size, sizeof(uint32_t), 1, fp) != 1) goto error;
+
+    if (fread(id, 1, RIFF_ID_LENGTH, fp) != RIFF_ID_LENGTH || memcmp(id, "WAVE", RIFF_ID_LENGTH)) goto error;
+
+    uint16_t numberOfChannels = 0;
+
+    while (fread(id, 1, RIFF_ID_LENGTH, fp) == RIFF_ID_LENGTH && fread(&size, sizeof(uint32_t), 1, fp) == 1) {
+
+        if (memcmp(id, "fmt ", RIFF_ID_LENGTH) == 0) {
+
+            uint16_t format[8];
+
+            if (size < sizeof(format) || fread(format, 1, sizeof(format), fp) != sizeof(format)) goto error;
+
+            if (format[0] != PCM_FORMAT || format[7] != BITS_PER_SAMPLE) goto error;
+
+            numberOfChannels = format[1];
+
+            fseek(fp, size - sizeof(format) + (size & 1), SEEK_CUR);
+
+        } else if (memcmp(id, "data", RIFF_ID_LENGTH) == 0) {
+
+            if (numberOfChannels == 0) goto error;
+
+            /* Keep the first channel and repeat the recording to fill the input buffer */
+
+            uint32_t numberOfFrames = size / numberOfChannels / sizeof(int16_t);
+
+            if (numberOfFrames == 0) goto error;
+
+            int16_t *frames = malloc(numberOfFrames * numberOfChannels * sizeof(int16_t));
+
+            numberOfFrames = fread(frames, numberOfChannels * sizeof(int16_t), numberOfFrames, fp);
+
+            for (uint32_t i = 0; i < numberOfSamples && numberOfFrames > 0; i += 1) {
+
+                input[i] = frames[(i % numberOfFrames) * numberOfChannels];
+
+            }
+
+            free(frames);
+
+            fclose(fp);
+
+            return numberOfFrames > 0;
+
+        } else {
+
+            fseek(fp, size + (size & 1), SEEK_CUR);
+
+        }
+
+    }
+
+error:
+
+    fclose(fp);
+
+    return false;
+
+}
+
+/* Function to replicate the DMA transfer size calculation in makeRecording() */
+
+static uint32_t calculateNumberOfRawSamplesInDMATransfer(uint32_t sampleRateDivider) {
+
+    uint32_t numberOfRawSamplesInDMATransfer = MAXIMUM_SAMPLES_IN_DMA_TRANSFER / sampleRateDivider;
+
+    while (numberOfRawSamplesInDMATransfer & (numberOfRawSamplesInDMATransfer - 1)) {
+
+        numberOfRawSamplesInDMATransfer = numberOfRawSamplesInDMATransfer & (numberOfRawSamplesInDMATransfer - 1);
+
+    }
+
+    return numberOfRawSamplesInDMATransfer * sampleRateDivider;
+
+}
+
+/* Functions to configure and run a single benchmark pass */
+
+static void configureFilter(const benchmarkCase_t *benchmarkCase, uint32_t blockingFilterFrequency) {
+
+    uint32_t effectiveSampleRate = INPUT_SAMPLE_RATE / benchmarkCase->sampleRateDivider;
+
+    DigitalFilter_reset();
+
+    if (benchmarkCase->filterType == DF_HIGH_PASS_FILTER) {
+
+        DigitalFilter_designHighPassFilter(effectiveSampleRate, blockingFilterFrequency);
+
+    } else {
+
+        DigitalFilter_designBandPassFilter(effectiveSampleRate, BAND_PASS_LOWER_FREQ, BAND_PASS_UPPER_FREQ);
+
+    }
+
+    DigitalFilter_designDecimationFilter(benchmarkCase->path == BM_DECIMATION ? DF_CIC_FIR_DECIMATION : DF_BOXCAR_DECIMATION, benchmarkCase->sampleRateDivider);
+
+    DigitalFilter_setAmplitudeThreshold(AMPLITUDE_THRESHOLD);
+
+    DigitalFilter_setSecondaryGain(DUAL_GAIN_SECONDARY_GAIN);
+
+    if (benchmarkCase->path == BM_GOERTZEL_THRESHOLD || benchmarkCase->path == BM_FREQUENCY_TRIGGER) {
+
+        DigitalFilter_setFrequencyTrigger(GOERTZEL_WINDOW_LENGTH, effectiveSampleRate, GOERTZEL_FREQUENCY, GOERTZEL_PERCENTAGE_THRESHOLD);
+
+    }
+
+}
+
+static uint32_t runPass(const benchmarkCase_t *benchmarkCase, uint32_t numberOfRawSamplesInDMATransfer, uint32_t numberOfTransfers) {
+
+    uint32_t numberOfTriggers = 0;
+
+    uint32_t numberOfOutputSamplesInDMATransfer = numberOfRawSamplesInDMATransfer / benchmarkCase->sampleRateDivider;
+
+    for (uint32_t i = 0; i < numberOfTransfers; i += 1) {
+
+        int16_t *source = input + i * numberOfRawSamplesInDMATransfer;
+
+        int16_t *dest = output + i * numberOfOutputSamplesInDMATransfer;
+
+        bool triggered;
+
+        if (benchmarkCase->path == BM_FREQUENCY_TRIGGER) {
+
+            triggered = DigitalFilter_applyFrequencyTrigger(source, numberOfRawSamplesInDMATransfer);
+
+        } else if (benchmarkCase->path == BM_EXTENDED) {
+
+            /* Packed 24-bit samples take three bytes each */
+
+            triggered = DigitalFilter_applyExtendedFilter(source, (uint8_t*)output + 3 * i * numberOfOutputSamplesInDMATransfer, benchmarkCase->sampleRateDivider, numberOfRawSamplesInDMATransfer);
+
+        } else if (benchmarkCase->path == BM_DUAL_GAIN) {
+
+            /* The secondary output is discarded into the reference buffer */
+
+            triggered = DigitalFilter_applyDualGainFilter(source, dest, reference + i * numberOfOutputSamplesInDMATransfer, benchmarkCase->sampleRateDivider, numberOfRawSamplesInDMATransfer);
+
+        } else {
+
+            triggered = DigitalFilter_applyFilter(source, dest, benchmarkCase->sampleRateDivider, numberOfRawSamplesInDMATransfer);
+
+        }
+
+        if (triggered) numberOfTriggers += 1;
+
+    }
+
+    return numberOfTriggers;
+
+}
+
+static uint32_t calculateChecksum(int16_t *samples, uint32_t numberOfSamples) {
+
+    uint32_t hash = 2166136261u;
+
+    for (uint32_t i = 0; i < numberOfSamples; i += 1) {
+
+        hash = (hash ^ (uint16_t)samples[i]) * 16777619u;
+
+    }
+
+    return hash;
+
+}
+
+static double elapsedSeconds(struct timespec *start, struct timespec *end) {
+
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / NANOSECONDS_IN_SECOND;
+
+}
+
+/* Function to measure the output level of a tone at a fraction of the output sample rate */
+
+static double measureToneLevel(BM_path_t path, uint32_t sampleRateDivider, double frequency) {
+
+    benchmarkCase_t benchmarkCase = {"", path, DF_HIGH_PASS_FILTER, sampleRateDivider};
+
+    uint32_t numberOfRawSamplesInDMATransfer = calculateNumberOfRawSamplesInDMATransfer(sampleRateDivider);
+
+    uint32_t numberOfTransfers = numberOfInputSamples / numberOfRawSamplesInDMATransfer;
+
+    uint32_t numberOfOutputSamplesInDMATransfer = numberOfRawSamplesInDMATransfer / sampleRateDivider;
+
+    for (uint32_t i = 0; i < numberOfTransfers * numberOfRawSamplesInDMATransfer; i += 1) {
+
+        reference[i] = (int16_t)round(TEST_TONE_AMPLITUDE * sin(2.0 * M_PI * frequency * (double)i / (double)sampleRateDivider));
+
+    }
+
+    configureFilter(&benchmarkCase, DEFAULT_DC_BLOCKING_FREQ);
+
+    double sumOfSquares = 0.0;
+
+    uint32_t numberOfSamples = 0;
+
+    for (uint32_t i = 0; i < numberOfTransfers; i += 1) {
+
+        DigitalFilter_applyFilter(reference + i * numberOfRawSamplesInDMATransfer, output, sampleRateDivider, numberOfRawSamplesInDMATransfer);
+
+        if (i < SETTLING_TRANSFERS) continue;
+
+        for (uint32_t j = 0; j < numberOfOutputSamplesInDMATransfer; j += 1) {
+
+            sumOfSquares += (double)output[j] * (double)output[j];
+
+        }
+
+        numberOfSamples += numberOfOutputSamplesInDMATransfer;
+
+    }
+
+    /* Level relative to the tone amplitude scaled by the boxcar gain */
+
+    double rms = sqrt(sumOfSquares / (double)MAX(1, numberOfSamples));
+
+    return 20.0 * log10(MAX(rms, 0.5) * sqrt(2.0) / (TEST_TONE_AMPLITUDE * sampleRateDivider));
+
+}
+
+/* Function to compare the alias rejection of the boxcar and CIC decimators */
+
+static void printAliasRejection(void) {
+
+    printf("%-42s %4s %14s %14s %14s %14s\n", "Alias rejection (dB)", "Div", "Boxcar pass", "Boxcar alias", "CIC pass", "CIC alias");
+
+    for (uint32_t i = 0; i < NUMBER_OF_ALIAS_DIVIDERS; i += 1) {
+
+        uint32_t sampleRateDivider = aliasSampleRateDividers[i];
+
+        printf("%-42s %4u %14.1f %14.1f %14.1f %14.1f\n", "", sampleRateDivider, measureToneLevel(BM_FILTER, sampleRateDivider, PASS_BAND_TONE_FREQUENCY), measureToneLevel(BM_FILTER, sampleRateDivider, ALIASED_TONE_FREQUENCY), measureToneLevel(BM_DECIMATION, sampleRateDivider, PASS_BAND_TONE_FREQUENCY), measureToneLevel(BM_DECIMATION, sampleRateDivider, ALIASED_TONE_FREQUENCY));
+
+    }
+
+    printf("\n");
+
+}
+
+/* Function to compare the per-sample Butterworth filters with the block biquad cascade used by the audio configuration demodulator */
+
+static void compareBiquadCascade(uint32_t repeats) {
+
+    BW_filter_t bandPassFilter, lowPassFilter;
+
+    BW_filterCoefficients_t bandPassCoefficients, lowPassCoefficients;
+
+    Butterworth_designBandPassFilter(&bandPassCoefficients, CONFIG_SAMPLE_RATE, CONFIG_CARRIER_FREQUENCY - CARRIER_FILTER_CUTOFF_FREQUENCY, CONFIG_CARRIER_FREQUENCY + CARRIER_FILTER_CUTOFF_FREQUENCY);
+
+    Butterworth_designLowPassFilter(&lowPassCoefficients, CONFIG_SAMPLE_RATE, AGC_FILTER_CUTOFF_FREQUENCY);
+
+    BQ_filterCoefficients_t sections[2];
+
+    Butterworth_designBandPassBiquad(sections, CONFIG_SAMPLE_RATE, CONFIG_CARRIER_FREQUENCY - CARRIER_FILTER_CUTOFF_FREQUENCY, CONFIG_CARRIER_FREQUENCY + CARRIER_FILTER_CUTOFF_FREQUENCY);
+
+    Butterworth_designLowPassBiquad(sections + 1, CONFIG_SAMPLE_RATE, AGC_FILTER_CUTOFF_FREQUENCY);
+
+    uint32_t numberOfSamples = numberOfInputSamples / CONFIG_SAMPLE_BLOCK_SIZE * CONFIG_SAMPLE_BLOCK_SIZE;
+
+    float *perSampleOutput = malloc(numberOfSamples * sizeof(float));
+
+    float *blockOutput = malloc(numberOfSamples * sizeof(float));
+
+    double bestPerSampleTime = 0.0, bestBlockTime = 0.0;
+
+    for (uint32_t j = 0; j < repeats; j += 1) {
+
+        struct timespec start, end;
+
+        Butterworth_initialise(&bandPassFilter);
+
+        Butterworth_initialise(&lowPassFilter);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (uint32_t i = 0; i < numberOfSamples; i += 1) {
+
+            perSampleOutput[i] = Butterworth_applyLowPassFilter(Butterworth_applyBandPassFilter(input[i], &bandPassFilter, &bandPassCoefficients), &lowPassFilter, &lowPassCoefficients);
+
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double time = elapsedSeconds(&start, &end);
+
+        if (j == 0 || time < bestPerSampleTime) bestPerSampleTime = time;
+
+        BQ_cascade_t cascade;
+
+        Biquad_initialiseCascade(&cascade, sections, 2);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (uint32_t i = 0; i < numberOfSamples; i += CONFIG_SAMPLE_BLOCK_SIZE) {
+
+            Biquad_applyCascadeToSamples(&cascade, input + i, blockOutput + i, CONFIG_SAMPLE_BLOCK_SIZE);
+
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        time = elapsedSeconds(&start, &end);
+
+        if (j == 0 || time < bestBlockTime) bestBlockTime = time;
+
+    }
+
+    /* Compare the outputs relative to the peak output */
+
+    double maximumOutput = 0.0, maximumError = 0.0;
+
+    for (uint32_t i = 0; i < numberOfSamples; i += 1) {
+
+        maximumOutput = MAX(maximumOutput, fabs(perSampleOutput[i]));
+
+        maximumError = MAX(maximumError, fabs(perSampleOutput[i] - blockOutput[i]));
+
+    }
+
+    printf("%-42s %14s %14s %14s\n", "Audio configuration filters", "Per-sample ns", "Block ns", "Max error (dB)");
+
+    printf("%-42s %14.2f %14.2f %14.1f\n\n", "", bestPerSampleTime * NANOSECONDS_IN_SECOND / numberOfSamples, bestBlockTime * NANOSECONDS_IN_SECOND / numberOfSamples, 20.0 * log10(MAX(maximumError, 1e-12) / MAX(maximumOutput, 1e-12)));
+
+    free(perSampleOutput);
+
+    free(blockOutput);
+
+}
+
+/* Usage message */
+
+static void printUsage(char *program) {
+
+    fprintf(stderr, "Usage: %s [-s seconds] [-r repeats] [-c host clock MHz] [-m host to Cortex-M4 cycle ratio] [file.wav]\n", program);
+
+    fprintf(stderr, "Pushes a 16-bit PCM WAV file, or synthetic noise if no file is given, through every digital filter path at %u Hz.\n", INPUT_SAMPLE_RATE);
+
+}
+
+/* Main function */
+
+int main(int argc, char **argv) {
+
+    uint32_t seconds = DEFAULT_BENCHMARK_SECONDS;
+
+    uint32_t repeats = DEFAULT_BENCHMARK_REPEATS;
+
+    float hostClockMHz = DEFAULT_HOST_CLOCK_MHZ;
+
+    float hostToCortexM4Ratio = DEFAULT_HOST_TO_CORTEX_M4_RATIO;
+
+    int option;
+
+    while ((option = getopt(argc, argv, "s:r:c:m:h")) != -1) {
+
+        if (option == 's') {
+
+            seconds = atoi(optarg);
+
+        } else if (option == 'r') {
+
+            repeats = atoi(optarg);
+
+        } else if (option == 'c') {
+
+            hostClockMHz = atof(optarg);
+
+        } else if (option == 'm') {
+
+            hostToCortexM4Ratio = atof(optarg);
+
+        } else {
+
+            printUsage(argv[0]);
+
+            return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+
+        }
+
+    }
+
+    if (seconds == 0 || repeats == 0 || hostClockMHz <= 0.0f || hostToCortexM4Ratio <= 0.0f) {
+
+        printUsage(argv[0]);
+
+        return EXIT_FAILURE;
+
+    }
+
+    /* Allocate buffers */
+
+    numberOfInputSamples = seconds * INPUT_SAMPLE_RATE;
+
+    input = malloc(numberOfInputSamples * sizeof(int16_t));
+
+    output = malloc(numberOfInputSamples * sizeof(int16_t));
+
+    reference = malloc(numberOfInputSamples * sizeof(int16_t));
+
+    if (input == NULL || output == NULL || reference == NULL) {
+
+        fprintf(stderr, "Could not allocate %u samples.\n", numberOfInputSamples);
+
+        return EXIT_FAILURE;
+
+    }
+
+    /* Load or generate the input */
+
+    if (optind < argc) {
+
+        if (loadWavFile(argv[optind], numberOfInputSamples) == false) {
+
+            fprintf(stderr, "Could not read 16-bit PCM WAV file %s.\n", argv[optind]);
+
+            return EXIT_FAILURE;
+
+        }
+
+        printf("Input: %s\n", argv[optind]);
+
+    } else {
+
+        generateSyntheticNoise(numberOfInputSamples);
+
+        printf("Input: synthetic noise\n");
+
+    }
+
+    /* Compare the alias rejection of the decimators */
+
+    printAliasRejection();
+
+    /* Compare the audio configuration filters */
+
+    compareBiquadCascade(repeats);
+
+    /* Cycle budget for each raw sample in the DMA interrupt */
+
+    float cortexM4BudgetCycles = (float)CORTEX_M4_CLOCK_FREQUENCY / (float)INPUT_SAMPLE_RATE;
+
+    printf("Input rate: %u Hz, %u s, best of %u passes\n", INPUT_SAMPLE_RATE, seconds, repeats);
+
+    printf("Cortex-M4 budget: %.1f cycles/sample at %u MHz\n", cortexM4BudgetCycles, CORTEX_M4_CLOCK_FREQUENCY / 1000000);
+
+    printf("M4 cycle and budget columns are host-relative estimates, not measured on the Cortex-M4 (%.0f MHz host, host to M4 cycle ratio %.1f)\n\n", hostClockMHz, hostToCortexM4Ratio);
+
+    printf("%-42s %-4s %4s %12s %10s %12s %12s %10s %10s\n", "Path", "Type", "Div", "Samples/s", "ns/sample", "Est. M4 cyc", "Est. budget", "Triggers", "Checksum");
+
+    for (uint32_t i = 0; i < NUMBER_OF_BENCHMARK_CASES; i += 1) {
+
+        const benchmarkCase_t *benchmarkCase = benchmarkCases + i;
+
+        uint32_t numberOfRawSamplesInDMATransfer = calculateNumberOfRawSamplesInDMATransfer(benchmarkCase->sampleRateDivider);
+
+        uint32_t numberOfTransfers = numberOfInputSamples / numberOfRawSamplesInDMATransfer;
+
+        uint32_t numberOfRawSamples = numberOfTransfers * numberOfRawSamplesInDMATransfer;
+
+        /* Take the fastest of the repeated passes */
+
+        double bestTime = 0.0;
+
+        uint32_t numberOfTriggers = 0;
+
+        for (uint32_t j = 0; j < repeats; j += 1) {
+
+            configureFilter(benchmarkCase, DEFAULT_DC_BLOCKING_FREQ);
+
+            struct timespec start, end;
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+
+            numberOfTriggers = runPass(benchmarkCase, numberOfRawSamplesInDMATransfer, numberOfTransfers);
+
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            double time = elapsedSeconds(&start, &end);
+
+            if (j == 0 || time < bestTime) bestTime = time;
+
+        }
+
+        /* Report throughput and the budget usage estimated from the host time. This is not a measurement on the Cortex-M4 */
+
+        double samplesPerSecond = (double)numberOfRawSamples / bestTime;
+
+        double nanosecondsPerSample = bestTime * NANOSECONDS_IN_SECOND / (double)numberOfRawSamples;
+
+        double cortexM4Cycles = nanosecondsPerSample * hostClockMHz / 1000.0 * hostToCortexM4Ratio;
+
+        uint32_t numberOfOutputSamples = benchmarkCase->path == BM_FREQUENCY_TRIGGER ? 0 : numberOfRawSamples / benchmarkCase->sampleRateDivider;
+
+        if (benchmarkCase->path == BM_EXTENDED) numberOfOutputSamples = 3 * numberOfOutputSamples / 2;
+
+        uint32_t checksum = numberOfOutputSamples == 0 ? numberOfTriggers : calculateChecksum(output, numberOfOutputSamples);
+
+        printf("%-42s %-4s %4u %12.0f %10.2f %12.1f %11.0f%% %10u %10.8X\n", benchmarkCase->name, benchmarkCase->filterType == DF_HIGH_PASS_FILTER ? "HPF" : "BPF", benchmarkCase->sampleRateDivider, samplesPerSecond, nanosecondsPerSample, cortexM4Cycles, 100.0 * cortexM4Cycles / cortexM4BudgetCycles, numberOfTriggers, checksum);
+
+    }
+
+    free(input);
+
+    free(output);
+
+    free(reference);
+
+    return EXIT_SUCCESS;
+
+}
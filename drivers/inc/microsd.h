@@ -62,6 +62,10 @@ extern "C" {
 #define CMD55     (55)        /**< APP_CMD */
 #define CMD58     (58)        /**< READ_OCR */
 
+/* Busy wait histogram bucket i counts waits of [2^(i-1), 2^i) ms, with
+ * bucket 0 counting waits under 1 ms and the last bucket everything longer */
+#define MICROSD_BUSY_HISTOGRAM_BUCKETS  10
+
 void      MICROSD_Init(void);
 void      MICROSD_Deinit(void);
 
@@ -79,6 +83,9 @@ int       MICROSD_BlockTx(const uint8_t *buff, uint8_t token);
 uint8_t   MICROSD_SendCmd(uint8_t cmd, DWORD arg);
 uint8_t   MICROSD_XferSpi(uint8_t data);
 
+void      MICROSD_GetBusyHistogram(uint32_t *histogram);
+void      MICROSD_ClearBusyHistogram(void);
+
 void      MICROSD_SpiClkFast(void);
 void      MICROSD_SpiClkSlow(void);
 
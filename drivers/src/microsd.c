@@ -20,6 +20,11 @@
 * the speed of the SPI clock when using a fast SD card.
 * openacousticdevices.info
 * March 2022
+*
+* Long busy periods are polled at a backed-off interval from a hardware
+* timer, sleeping in EM1 between polls, and recorded in a latency histogram.
+* openacousticdevices.info
+* October 2026
 *******************************************************************************/
 
 #include "diskio.h"
@@ -27,6 +32,11 @@
 #include "em_cmu.h"
 #include "em_usart.h"
 
+#if MICROSD_USE_TIMED_BUSY_WAIT
+#include "em_emu.h"
+#include "em_timer.h"
+#endif
+
 /**************************************************************************//**
  * @addtogroup MicroSd
  * @{ This module implements the SPI layer needed to control a micro SD card.
@@ -36,6 +46,129 @@
 static uint32_t timeOut, xfersPrMsec;
 static bool doubleSpiClkFast;
 
+static uint32_t busyHistogram[MICROSD_BUSY_HISTOGRAM_BUCKETS];
+
+#if MICROSD_USE_TIMED_BUSY_WAIT
+
+/**************************************************************************//**
+ * @brief Sleep in EM1 until an interrupt handler sets a flag.
+ * @details Interrupts are masked around the check so that an interrupt
+ *  between the check and the WFI still wakes the core.
+ *****************************************************************************/
+static void SleepUntil(volatile bool *flag)
+{
+  while (true) {
+    __disable_irq();
+
+    if (*flag) {
+      __enable_irq();
+      break;
+    }
+
+    EMU_EnterEM1();
+
+    __enable_irq();
+  }
+}
+
+#endif
+
+/**************************************************************************//**
+ * @brief Add a busy wait duration to the latency histogram.
+ *****************************************************************************/
+static void RecordBusyDuration(uint32_t microseconds)
+{
+  uint32_t bucket = 0;
+  uint32_t milliseconds = microseconds / 1000;
+
+  while (milliseconds && bucket < MICROSD_BUSY_HISTOGRAM_BUCKETS - 1) {
+    milliseconds >>= 1;
+    bucket += 1;
+  }
+
+  busyHistogram[bucket] += 1;
+}
+
+#if MICROSD_USE_TIMED_BUSY_WAIT
+
+static volatile bool busyTimerExpired;
+
+/**************************************************************************//**
+ * @brief Busy timer interrupt handler.
+ *****************************************************************************/
+void MICROSD_BUSY_TIMER_IRQHandler(void)
+{
+  uint32_t interruptMask = TIMER_IntGet(MICROSD_BUSY_TIMER);
+
+  TIMER_IntClear(MICROSD_BUSY_TIMER, interruptMask);
+
+  if (interruptMask & TIMER_IF_OF) {
+    busyTimerExpired = true;
+  }
+}
+
+/**************************************************************************//**
+ * @brief Wait for a busy micro SD card by polling at a backed-off interval.
+ * @details The card can be busy for hundreds of milliseconds during an
+ *  internal erase or program. Rather than clocking 0xff continuously the
+ *  card is polled once per interval, starting at MICROSD_BUSY_MIN_INTERVAL_US
+ *  and doubling up to MICROSD_BUSY_MAX_INTERVAL_US, with the core in EM1
+ *  between polls.
+ * @param[out] elapsed Approximate duration of the wait in microseconds.
+ * @return 0xff: micro SD card ready, other value: micro SD card not ready.
+ *****************************************************************************/
+static uint8_t TimedWaitReady(uint32_t *elapsed)
+{
+  uint8_t res;
+  uint32_t interval = MICROSD_BUSY_MIN_INTERVAL_US;
+  uint32_t ticksPerMsec;
+  TIMER_Init_TypeDef timerInit = TIMER_INIT_DEFAULT;
+
+  CMU_ClockEnable(MICROSD_BUSY_TIMER_CLOCK, true);
+
+  timerInit.enable   = false;
+  timerInit.prescale = timerPrescale16;
+  timerInit.oneShot  = true;
+
+  TIMER_Init(MICROSD_BUSY_TIMER, &timerInit);
+
+  ticksPerMsec = CMU_ClockFreqGet(MICROSD_BUSY_TIMER_CLOCK) / 16 / 1000;
+
+  TIMER_IntClear(MICROSD_BUSY_TIMER, TIMER_IF_OF);
+  TIMER_IntEnable(MICROSD_BUSY_TIMER, TIMER_IF_OF);
+
+  NVIC_ClearPendingIRQ(MICROSD_BUSY_TIMER_IRQn);
+  NVIC_EnableIRQ(MICROSD_BUSY_TIMER_IRQn);
+
+  *elapsed = 0;
+
+  do {
+    busyTimerExpired = false;
+
+    TIMER_TopSet(MICROSD_BUSY_TIMER, interval * ticksPerMsec / 1000);
+    TIMER_CounterSet(MICROSD_BUSY_TIMER, 0);
+    TIMER_Enable(MICROSD_BUSY_TIMER, true);
+
+    SleepUntil(&busyTimerExpired);
+
+    *elapsed += interval;
+
+    interval = interval * 2 < MICROSD_BUSY_MAX_INTERVAL_US ? interval * 2 : MICROSD_BUSY_MAX_INTERVAL_US;
+
+    res = MICROSD_XferSpi(0xff);
+  } while ((res != 0xFF) && *elapsed < MICROSD_BUSY_TIMEOUT_US);
+
+  TIMER_IntDisable(MICROSD_BUSY_TIMER, TIMER_IF_OF);
+  NVIC_DisableIRQ(MICROSD_BUSY_TIMER_IRQn);
+
+  TIMER_Reset(MICROSD_BUSY_TIMER);
+  CMU_ClockEnable(MICROSD_BUSY_TIMER_CLOCK, false);
+
+  return res;
+}
+
+#endif /* MICROSD_USE_TIMED_BUSY_WAIT */
+
 /**************************************************************************//**
  * @brief Wait for micro SD card ready.
  * @return 0xff: micro SD card ready, other value: micro SD card not ready.
@@ -43,14 +176,33 @@ static bool doubleSpiClkFast;
 static uint8_t WaitReady(void)
 {
   uint8_t res;
-  uint32_t retryCount;
+  uint32_t retryCount, polls, elapsed;
 
+#if MICROSD_USE_TIMED_BUSY_WAIT
+  /* The card is usually ready within a few transfers so poll briefly first */
+  retryCount = MICROSD_BUSY_FAST_POLLS;
+#else
   /* Wait for ready in timeout of 500ms */
   retryCount = 500 * xfersPrMsec;
+#endif
+  polls = retryCount;
   do {
     res = MICROSD_XferSpi(0xff);
   } while ((res != 0xFF) && --retryCount);
 
+  elapsed = (polls - retryCount) * 1000 / xfersPrMsec;
+
+#if MICROSD_USE_TIMED_BUSY_WAIT
+  if (res != 0xFF) {
+    res = TimedWaitReady(&elapsed);
+  }
+#endif
+
+  /* Only waits where the card reported busy are recorded */
+  if (polls - retryCount > 1 || res != 0xFF) {
+    RecordBusyDuration(elapsed);
+  }
+
   return res;
 }
 /** @endcond */
@@ -330,6 +482,31 @@ int MICROSD_BlockTx(const uint8_t *buff, uint8_t token)
 }
 #endif /* _READONLY */
 
+/**************************************************************************//**
+ * @brief Copy the busy wait latency histogram.
+ * @param[out] histogram MICROSD_BUSY_HISTOGRAM_BUCKETS counts.
+ *****************************************************************************/
+void MICROSD_GetBusyHistogram(uint32_t *histogram)
+{
+  int i;
+
+  for (i = 0; i < MICROSD_BUSY_HISTOGRAM_BUCKETS; i++) {
+    histogram[i] = busyHistogram[i];
+  }
+}
+
+/**************************************************************************//**
+ * @brief Clear the busy wait latency histogram.
+ *****************************************************************************/
+void MICROSD_ClearBusyHistogram(void)
+{
+  int i;
+
+  for (i = 0; i < MICROSD_BUSY_HISTOGRAM_BUCKETS; i++) {
+    busyHistogram[i] = 0;
+  }
+}
+
 /**************************************************************************//**
  * @brief
  *  Send a command packet to micro SD card.
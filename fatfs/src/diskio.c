@@ -97,7 +97,7 @@ DRESULT disk_read (
   BYTE drv,       /* Physical drive nmuber (0) */
   BYTE *buff,     /* Pointer to the data buffer to store read data */
   DWORD sector,   /* Start sector number (LBA) */
-  BYTE count      /* Sector count (1..255) */
+  UINT count      /* Sector count */
 )
 {
   if (drv || !count) return RES_PARERR;
@@ -133,7 +133,7 @@ DRESULT disk_write (
   BYTE drv,           /* Physical drive nmuber (0) */
   const BYTE *buff,   /* Pointer to the data to be written */
   DWORD sector,       /* Start sector number (LBA) */
-  BYTE count          /* Sector count (1..255) */
+  UINT count          /* Sector count */
 )
 {
   if (drv || !count) return RES_PARERR;
@@ -23,4 +23,6 @@ bool AudioConfig_listenForAudioConfigurationPackets(bool timeout, uint32_t milli
 
 void AudioConfig_cancelAudioConfiguration(void);
 
+uint32_t AudioConfig_getNumberOfDroppedBlocks(void);
+
 #endif /* __AUDIOCONFIG_H */
@@ -19,8 +19,8 @@
 #define AM_EXTERNAL_SRAM_SIZE_IN_BYTES         (256 * 1024)
 
 #define AM_BACKUP_DOMAIN_START_ADDRESS         0x40081120
-#define AM_BACKUP_DOMAIN_SIZE_IN_REGISTERS     120
-#define AM_BACKUP_DOMAIN_SIZE_IN_BYTES         480
+#define AM_BACKUP_DOMAIN_SIZE_IN_REGISTERS     117
+#define AM_BACKUP_DOMAIN_SIZE_IN_BYTES         468
 
 #define AM_FLASH_USER_DATA_ADDRESS             0xFE00000
 #define AM_FLASH_USER_SIZE_IN_BYTES            2048
@@ -32,7 +32,11 @@
 #define AM_EXT_BAT_STATE_OFFSET                2400
 #define AM_BATTERY_STATE_INCREMENT             100
 
-/* Gain, SD card speed, switch, frequency and battery state enumerations */
+#define AM_NUMBER_OF_FILES                     3
+
+#define AM_SD_CARD_BUSY_HISTOGRAM_BINS         10
+
+/* Gain, SD card speed, switch, file, frequency and battery state enumerations */
 
 typedef enum {AM_LOW_GAIN_RANGE, AM_NORMAL_GAIN_RANGE} AM_gainRange_t;
 
@@ -44,6 +48,8 @@ typedef enum {AM_SWITCH_CUSTOM, AM_SWITCH_DEFAULT, AM_SWITCH_USB, AM_SWITCH_NONE
 
 typedef enum {AM_GAIN_LOW, AM_GAIN_LOW_MEDIUM, AM_GAIN_MEDIUM, AM_GAIN_MEDIUM_HIGH, AM_GAIN_HIGH} AM_gainSetting_t;
 
+typedef enum {AM_PRIMARY_FILE, AM_SECONDARY_FILE, AM_FOLLOWING_FILE} AM_file_t;
+
 typedef enum {AM_HFRCO_1MHZ, AM_HFRCO_7MHZ, AM_HFRCO_11MHZ, AM_HFRCO_14MHZ, AM_HFRCO_21MHZ, AM_HFRCO_28MHZ} AM_clockFrequency_t;
 
 typedef enum {AM_BATTERY_LOW, AM_BATTERY_3V6, AM_BATTERY_3V7, AM_BATTERY_3V8, AM_BATTERY_3V9, AM_BATTERY_4V0, AM_BATTERY_4V1, AM_BATTERY_4V2, \
@@ -111,6 +117,8 @@ void AudioMoth_initialiseDirectMemoryAccess(int16_t *primaryBuffer, int16_t *sec
 bool AudioMoth_enableMicrophone(AM_gainRange_t gainRange, AM_gainSetting_t gainSetting, uint32_t clockDivider, uint32_t acquisitionCycles, uint32_t oversampleRate);
 void AudioMoth_disableMicrophone(void);
 
+void AudioMoth_setMicrophoneGain(AM_gainRange_t gainRange, AM_gainSetting_t gainSetting);
+
 /* USB */
 
 void AudioMoth_handleUSB(void);
@@ -181,7 +189,7 @@ int32_t AudioMoth_getTemperature(void);
 
 AM_switchPosition_t AudioMoth_getSwitchPosition(void);
 
-/* Busy delay */
+/* Sleeping delay, in EM2 when long enough */
 
 void AudioMoth_delay(uint32_t milliseconds);
 
@@ -204,6 +212,10 @@ void AudioMoth_setGreenLED(bool state);
 
 bool AudioMoth_enableFileSystem(AM_sdCardSpeed_t speed);
 void AudioMoth_disableFileSystem(void);
+void AudioMoth_clearFileSystemCache(void);
+
+void AudioMoth_selectFile(AM_file_t file);
+void AudioMoth_swapFiles(AM_file_t firstFile, AM_file_t secondFile);
 
 bool AudioMoth_doesFileExist(char *filename);
 
@@ -213,9 +225,13 @@ bool AudioMoth_readFile(char *buffer, uint32_t bufferSize);
 bool AudioMoth_appendFile(char *filename);
 
 bool AudioMoth_seekInFile(uint32_t position);
-bool AudioMoth_writeToFile(void *bytes, uint16_t bytesToWrite);
+bool AudioMoth_writeToFile(void *bytes, uint32_t bytesToWrite);
+
+bool AudioMoth_expandFile(uint32_t size);
+bool AudioMoth_truncateFile(void);
 
 bool AudioMoth_renameFile(char *originalFilename, char *newFilename);
+bool AudioMoth_deleteFile(char *filename);
 
 bool AudioMoth_doesDirectoryExist(char *folderName);
 bool AudioMoth_makeDirectory(char *folderName);
@@ -223,6 +239,9 @@ bool AudioMoth_makeDirectory(char *folderName);
 bool AudioMoth_syncFile(void);
 bool AudioMoth_closeFile(void);
 
+void AudioMoth_getSDCardBusyHistogram(uint32_t *histogram);
+void AudioMoth_clearSDCardBusyHistogram(void);
+
 /* Debugging */
 
 void AudioMoth_setupSWOForPrint(void);
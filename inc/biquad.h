@@ -9,6 +9,8 @@
 
 #include <stdint.h>
 
+#define BQ_MAXIMUM_NUMBER_OF_SECTIONS       4
+
 typedef struct {
     float xv[3];
     float yv[3];
@@ -22,6 +24,12 @@ typedef struct {
     float A2_A0;
 } BQ_filterCoefficients_t;
 
+typedef struct {
+    uint32_t numberOfSections;
+    const BQ_filterCoefficients_t *coefficients;
+    float state[BQ_MAXIMUM_NUMBER_OF_SECTIONS][2];
+} BQ_cascade_t;
+
 void Biquad_designLowPassFilter(BQ_filterCoefficients_t *coefficients, uint32_t sampleRate, uint32_t frequency, float bandwidth);
 
 void Biquad_designHighPassFilter(BQ_filterCoefficients_t *coefficients, uint32_t sampleRate, uint32_t frequency, float bandwidth);
@@ -34,4 +42,10 @@ void Biquad_initialise(BQ_filter_t *filter);
 
 float Biquad_applyFilter(float sample, BQ_filter_t *filter, BQ_filterCoefficients_t *filterCoefficients);
 
+void Biquad_initialiseCascade(BQ_cascade_t *cascade, const BQ_filterCoefficients_t *coefficients, uint32_t numberOfSections);
+
+void Biquad_applyCascadeToSamples(BQ_cascade_t *cascade, const int16_t *source, float *dest, uint32_t size);
+
+void Biquad_applyCascade(BQ_cascade_t *cascade, const float *source, float *dest, uint32_t size);
+
 #endif /* __BIQUAD_H */
@@ -9,6 +9,8 @@
 
 #include <stdint.h>
 
+#include "biquad.h"
+
 typedef struct {
     float xv[3];
     float yv[3];
@@ -25,6 +27,12 @@ void Butterworth_designHighPassFilter(BW_filterCoefficients_t *filterCoefficient
 
 void Butterworth_designBandPassFilter(BW_filterCoefficients_t *filterCoefficients, uint32_t sampleRate, uint32_t freq1, uint32_t freq2);
 
+void Butterworth_designLowPassBiquad(BQ_filterCoefficients_t *coefficients, uint32_t sampleRate, uint32_t freq);
+
+void Butterworth_designHighPassBiquad(BQ_filterCoefficients_t *coefficients, uint32_t sampleRate, uint32_t freq);
+
+void Butterworth_designBandPassBiquad(BQ_filterCoefficients_t *coefficients, uint32_t sampleRate, uint32_t freq1, uint32_t freq2);
+
 void Butterworth_initialise(BW_filter_t *filter);
 
 float Butterworth_applyLowPassFilter(float sample, BW_filter_t *filter, BW_filterCoefficients_t *filterCoefficients);
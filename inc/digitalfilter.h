@@ -14,12 +14,18 @@
 
 typedef enum {DF_BAND_PASS_FILTER, DF_HIGH_PASS_FILTER} DF_filterType_t;
 
+typedef enum {DF_BOXCAR_DECIMATION, DF_CIC_FIR_DECIMATION} DF_decimationType_t;
+
 /* Apply filters */
 
 void DigitalFilter_reset();
 
 bool DigitalFilter_applyFilter(int16_t *source, int16_t *dest, uint32_t sampleRateDivider, uint32_t size);
 
+bool DigitalFilter_applyDualGainFilter(int16_t *source, int16_t *dest, int16_t *secondaryDest, uint32_t sampleRateDivider, uint32_t size);
+
+bool DigitalFilter_applyExtendedFilter(int16_t *source, uint8_t *dest, uint32_t sampleRateDivider, uint32_t size);
+
 bool DigitalFilter_applyFrequencyTrigger(int16_t *source, uint32_t size);
 
 /* Design filters */
@@ -28,10 +34,14 @@ void DigitalFilter_designHighPassFilter(uint32_t sampleRate, uint32_t freq);
 
 void DigitalFilter_designBandPassFilter(uint32_t sampleRate, uint32_t freq1, uint32_t freq2);
 
+void DigitalFilter_designDecimationFilter(DF_decimationType_t type, uint32_t sampleRateDivider);
+
 /* Set filter options */
 
 void DigitalFilter_setAdditionalGain(float gain);
 
+void DigitalFilter_setSecondaryGain(float gain);
+
 void DigitalFilter_setAmplitudeThreshold(uint16_t amplitudeThreshold);
 
 void DigitalFilter_setFrequencyTrigger(uint32_t windowLength, uint32_t sampleRate, uint32_t frequency, float percentageThreshold);
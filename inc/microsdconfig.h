@@ -18,4 +18,14 @@
 #define MICROSD_CSPIN           6
 #define MICROSD_CLKPIN          5
 
+#define MICROSD_USE_TIMED_BUSY_WAIT     true
+#define MICROSD_BUSY_TIMER              TIMER3
+#define MICROSD_BUSY_TIMER_CLOCK        cmuClock_TIMER3
+#define MICROSD_BUSY_TIMER_IRQn         TIMER3_IRQn
+#define MICROSD_BUSY_TIMER_IRQHandler   TIMER3_IRQHandler
+#define MICROSD_BUSY_FAST_POLLS         64
+#define MICROSD_BUSY_MIN_INTERVAL_US    100
+#define MICROSD_BUSY_MAX_INTERVAL_US    2000
+#define MICROSD_BUSY_TIMEOUT_US         500000
+
 #endif /* __MICROSDCONFIG_H */
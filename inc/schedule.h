@@ -0,0 +1,88 @@
+/****************************************************************************
+ * schedule.h
+ * openacousticdevices.info
+ * October 2026
+ *****************************************************************************/
+
+#ifndef __SCHEDULE_H
+#define __SCHEDULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Schedule constants */
+
+#define SC_MAX_RECORDING_PERIODS                5
+
+#define SC_MAX_TIMELINE_EVENTS                  (SC_MAX_RECORDING_PERIODS + 2)
+
+/* Recording period data structure as stored in the configuration */
+
+#pragma pack(push, 1)
+
+typedef struct {
+    uint16_t startMinutes;
+    uint16_t endMinutes;
+} SC_recordingPeriod_t;
+
+#pragma pack(pop)
+
+/* Gain step recorded after gain2 in the same wake-up, and a recording in the sequence of a wake-up. The gain is an AM_gainSetting_t value */
+
+typedef struct {
+    uint32_t gain;
+    uint32_t duration;
+    uint32_t sleepDurationBefore;
+} SC_gainStep_t;
+
+typedef struct {
+    uint32_t time;
+    uint32_t duration;
+    uint32_t gain;
+} SC_recordingStep_t;
+
+/* Schedule settings taken from the configuration */
+
+typedef struct {
+    uint32_t recordDurationGain1;
+    uint32_t sleepDurationBetweenGains;
+    uint32_t recordDurationGain2;
+    uint32_t sleepDuration;
+    uint32_t additionalRecordDuration;
+    uint32_t numberOfAdditionalGainSteps;
+    const SC_gainStep_t *additionalGainSteps;
+    bool disableSleepRecordCycle;
+    uint32_t earliestRecordingTime;
+    uint32_t latestRecordingTime;
+    uint32_t activeRecordingPeriods;
+    SC_recordingPeriod_t *recordingPeriods;
+} SC_settings_t;
+
+/* Compiled recording timeline. Each event is a recording period, with the last period of the previous day first and the first period of the following day last. The end offsets are a running maximum so they can be binary searched */
+
+typedef struct {
+    int32_t startOffset;
+    uint32_t duration;
+    int32_t endOffset;
+} SC_timelineEvent_t;
+
+typedef struct {
+    uint32_t numberOfEvents;
+    SC_timelineEvent_t events[SC_MAX_TIMELINE_EVENTS];
+} SC_timeline_t;
+
+/* Set the additional gain steps and the time they take from the sleep phase */
+
+void Schedule_setAdditionalGainSteps(SC_settings_t *settings, const SC_gainStep_t *additionalGainSteps, uint32_t numberOfAdditionalGainSteps);
+
+/* Compile and search the timeline */
+
+void Schedule_compileTimeline(SC_settings_t *settings, SC_timeline_t *timeline);
+
+uint32_t Schedule_getEndOfRecordingPeriod(SC_settings_t *settings, SC_timeline_t *timeline, uint32_t time);
+
+void Schedule_scheduleRecording(SC_settings_t *settings, SC_timeline_t *timeline, uint32_t currentTime, uint32_t *timeOfNextRecordingGain1, uint32_t *durationOfNextRecordingGain1, uint32_t *timeOfNextRecordingGain2, uint32_t *durationOfNextRecordingGain2, uint32_t *startOfRecordingPeriod, uint32_t *endOfRecordingPeriod);
+
+uint32_t Schedule_getAdditionalRecordings(SC_settings_t *settings, SC_timeline_t *timeline, uint32_t timeOfRecordingGain1, uint32_t timeOfRecordingGain2, uint32_t durationOfRecordingGain2, SC_recordingStep_t *steps);
+
+#endif /* __SCHEDULE_H */
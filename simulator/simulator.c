@@ -0,0 +1,614 @@
+/****************************************************************************
+ * simulator.c
+ * openacousticdevices.info
+ * October 2026
+ *****************************************************************************/
+
+#include <time.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "schedule.h"
+
+/* Useful time constants */
+
+#define MILLISECONDS_IN_SECOND                  1000
+#define SECONDS_IN_MINUTE                       60
+#define SECONDS_IN_HOUR                         (60 * SECONDS_IN_MINUTE)
+#define SECONDS_IN_DAY                          (24 * SECONDS_IN_HOUR)
+
+#define MINUTES_IN_HOUR                         60
+#define MINUTES_IN_DAY                          1440
+
+/* WAV file constants. These match the 16-bit and 24-bit output of the firmware */
+
+#define WAV_HEADER_SIZE                         512
+#define EXTENDED_WAV_HEADER_SIZE                1536
+
+#define NUMBER_OF_BYTES_IN_SAMPLE               2
+#define NUMBER_OF_BYTES_IN_EXTENDED_SAMPLE      3
+
+/* Configuration file constants */
+
+#define CONFIG_LINE_LENGTH                      256
+#define CONFIG_KEY_SEPARATOR                    ": "
+
+#define NUMBER_OF_GAIN_SETTINGS                 5
+
+#define MAX_ADDITIONAL_GAIN_STEPS               8
+
+#define MAX_RECORDING_STEPS                     (2 + MAX_ADDITIONAL_GAIN_STEPS)
+
+/* Simulation defaults. The currents are placeholders and should be replaced with values measured on the deployed hardware */
+
+#define DEFAULT_SIMULATION_DAYS                 90
+#define DEFAULT_PREPARATION_PERIOD              2000
+#define DEFAULT_CLUSTER_SIZE                    32768
+
+#define DEFAULT_SLEEP_CURRENT_UA                30.0
+#define DEFAULT_AWAKE_CURRENT_MA                5.0
+#define DEFAULT_RECORDING_CURRENT_MA            15.0
+#define DEFAULT_BATTERY_CAPACITY_MAH            2500.0
+
+/* Useful macros */
+
+#define ROUNDED_UP_DIV(a, b)                    (((a) + (b) - 1) / (b))
+
+#define ROUND_UP_TO_MULTIPLE(a, b)              (((a) + (b) - 1) & ~((b)-1))
+
+#define MIN(a, b)                               ((a) < (b) ? (a) : (b))
+
+#define MAX(a, b)                               ((a) > (b) ? (a) : (b))
+
+/* Configuration read from CONFIG.TXT */
+
+typedef struct {
+    uint32_t sampleRate;
+    uint32_t gain1;
+    uint32_t gain2;
+    int32_t timezoneMinutes;
+    uint32_t recordDurationGain1;
+    uint32_t sleepDurationBetweenGains;
+    uint32_t recordDurationGain2;
+    uint32_t sleepDuration;
+    bool disableSleepRecordCycle;
+    uint32_t earliestRecordingTime;
+    uint32_t latestRecordingTime;
+    uint32_t activeRecordingPeriods;
+    SC_recordingPeriod_t recordingPeriods[SC_MAX_RECORDING_PERIODS];
+    uint32_t numberOfAdditionalGainSteps;
+    SC_gainStep_t additionalGainSteps[MAX_ADDITIONAL_GAIN_STEPS];
+} configuration_t;
+
+static char *gainSettings[NUMBER_OF_GAIN_SETTINGS] = {"Low", "Low-Medium", "Medium", "Medium-High", "High"};
+
+static char *filenameGainSettings[NUMBER_OF_GAIN_SETTINGS] = {"Low", "LowMedium", "Medium", "MediumHigh", "High"};
+
+/* Projection totals */
+
+typedef struct {
+    uint32_t numberOfFiles;
+    uint64_t numberOfBytes;
+    uint64_t numberOfBytesOnCard;
+    uint64_t recordingSeconds;
+    uint64_t awakeSeconds;
+    uint64_t totalSeconds;
+    uint32_t numberOfOverlappingSteps;
+} projection_t;
+
+/* Functions to parse CONFIG.TXT */
+
+static char* trim(char *text) {
+
+    while (isspace((unsigned char)*text)) text += 1;
+
+    char *end = text + strlen(text);
+
+    while (end > text && isspace((unsigned char)*(end - 1))) end -= 1;
+
+    *end = 0;
+
+    return text;
+
+}
+
+static bool parseGain(char *value, uint32_t *gain) {
+
+    for (uint32_t i = 0; i < NUMBER_OF_GAIN_SETTINGS; i += 1) {
+
+        if (strcmp(value, gainSettings[i]) == 0) {
+
+            *gain = i;
+
+            return true;
+
+        }
+
+    }
+
+    return false;
+
+}
+
+static bool parseTimezone(char *value, int32_t *timezoneMinutes) {
+
+    if (strncmp(value, "UTC", 3) != 0) return false;
+
+    value += 3;
+
+    int32_t sign = *value == '-' ? -1 : 1;
+
+    if (*value == '-' || *value == '+') value += 1;
+
+    int hours = 0, minutes = 0;
+
+    if (*value) sscanf(value, "%d:%d", &hours, &minutes);
+
+    *timezoneMinutes = sign * (hours * MINUTES_IN_HOUR + minutes);
+
+    return true;
+
+}
+
+static bool parseDuration(char *value, uint32_t *duration, bool *disableSleepRecordCycle) {
+
+    if (strcmp(value, "-") == 0) {
+
+        *disableSleepRecordCycle = true;
+
+        return true;
+
+    }
+
+    return sscanf(value, "%u", duration) == 1;
+
+}
+
+static bool parseRecordingPeriod(char *value, int32_t timezoneMinutes, SC_recordingPeriod_t *period) {
+
+    unsigned int startHours, startMinutes, endHours, endMinutes;
+
+    if (sscanf(value, "%u:%u - %u:%u", &startHours, &startMinutes, &endHours, &endMinutes) != 4) return false;
+
+    /* The periods are shown in local time and stored in UTC */
+
+    period->startMinutes = (MINUTES_IN_DAY + startHours * MINUTES_IN_HOUR + startMinutes - timezoneMinutes) % MINUTES_IN_DAY;
+
+    period->endMinutes = (MINUTES_IN_DAY + endHours * MINUTES_IN_HOUR + endMinutes - timezoneMinutes) % MINUTES_IN_DAY;
+
+    return true;
+
+}
+
+static bool parseDateTime(char *value, int32_t timezoneMinutes, bool isLastDate, uint32_t *timestamp) {
+
+    if (value[0] == '-') {
+
+        *timestamp = 0;
+
+        return true;
+
+    }
+
+    struct tm time;
+
+    memset(&time, 0, sizeof(struct tm));
+
+    int fields = sscanf(value, "%d-%d-%d %d:%d:%d", &time.tm_year, &time.tm_mon, &time.tm_mday, &time.tm_hour, &time.tm_min, &time.tm_sec);
+
+    if (fields != 3 && fields != 6) return false;
+
+    time.tm_year -= 1900;
+
+    time.tm_mon -= 1;
+
+    int64_t localTime = timegm(&time);
+
+    /* A last recording date is inclusive so recording stops at the following midnight */
+
+    if (fields == 3 && isLastDate) localTime += SECONDS_IN_DAY;
+
+    *timestamp = localTime - timezoneMinutes * SECONDS_IN_MINUTE;
+
+    return true;
+
+}
+
+static bool parseGainStep(char *value, SC_gainStep_t *gainStep) {
+
+    static char gain[CONFIG_LINE_LENGTH];
+
+    if (sscanf(value, "%[^,], %u s after %u s", gain, &gainStep->duration, &gainStep->sleepDurationBefore) != 3) return false;
+
+    return parseGain(gain, &gainStep->gain);
+
+}
+
+static int compareRecordingPeriods(const void *a, const void *b) {
+
+    return ((SC_recordingPeriod_t*)a)->startMinutes - ((SC_recordingPeriod_t*)b)->startMinutes;
+
+}
+
+static bool readConfiguration(char *filename, configuration_t *configuration) {
+
+    FILE *file = fopen(filename, "r");
+
+    if (file == NULL) return false;
+
+    memset(configuration, 0, sizeof(configuration_t));
+
+    static char line[CONFIG_LINE_LENGTH];
+
+    bool success = true;
+
+    bool foundSampleRate = false;
+
+    while (success && fgets(line, CONFIG_LINE_LENGTH, file)) {
+
+        char *separator = strstr(line, CONFIG_KEY_SEPARATOR);
+
+        if (separator == NULL) continue;
+
+        *separator = 0;
+
+        char *key = trim(line);
+
+        char *value = trim(separator + strlen(CONFIG_KEY_SEPARATOR));
+
+        if (strcmp(key, "Sample rate (Hz)") == 0) {
+
+            foundSampleRate = sscanf(value, "%u", &configuration->sampleRate) == 1 && configuration->sampleRate > 0;
+
+            success = foundSampleRate;
+
+        } else if (strcmp(key, "Gain1") == 0) {
+
+            success = parseGain(value, &configuration->gain1);
+
+        } else if (strcmp(key, "Gain2") == 0) {
+
+            success = parseGain(value, &configuration->gain2);
+
+        } else if (strcmp(key, "Time zone") == 0) {
+
+            success = parseTimezone(value, &configuration->timezoneMinutes);
+
+        } else if (strcmp(key, "Sleep duration (s)") == 0) {
+
+            success = parseDuration(value, &configuration->sleepDuration, &configuration->disableSleepRecordCycle);
+
+        } else if (strcmp(key, "Sleep betweenGains (s)") == 0) {
+
+            success = parseDuration(value, &configuration->sleepDurationBetweenGains, &configuration->disableSleepRecordCycle);
+
+        } else if (strcmp(key, "Recording duration gain 1 (s)") == 0) {
+
+            success = parseDuration(value, &configuration->recordDurationGain1, &configuration->disableSleepRecordCycle);
+
+        } else if (strcmp(key, "Recording duration gain 2 (s)") == 0) {
+
+            success = parseDuration(value, &configuration->recordDurationGain2, &configuration->disableSleepRecordCycle);
+
+        } else if (strncmp(key, "Recording period ", strlen("Recording period ")) == 0) {
+
+            if (configuration->activeRecordingPeriods < SC_MAX_RECORDING_PERIODS) {
+
+                success = parseRecordingPeriod(value, configuration->timezoneMinutes, configuration->recordingPeriods + configuration->activeRecordingPeriods);
+
+                configuration->activeRecordingPeriods += 1;
+
+            }
+
+        } else if (strncmp(key, "Additional gain step ", strlen("Additional gain step ")) == 0) {
+
+            if (configuration->numberOfAdditionalGainSteps < MAX_ADDITIONAL_GAIN_STEPS) {
+
+                success = parseGainStep(value, configuration->additionalGainSteps + configuration->numberOfAdditionalGainSteps);
+
+                configuration->numberOfAdditionalGainSteps += 1;
+
+            }
+
+        } else if (strcmp(key, "First recording date") == 0 || strcmp(key, "First recording time") == 0) {
+
+            success = parseDateTime(value, configuration->timezoneMinutes, false, &configuration->earliestRecordingTime);
+
+        } else if (strcmp(key, "Last recording date") == 0 || strcmp(key, "Last recording time") == 0) {
+
+            success = parseDateTime(value, configuration->timezoneMinutes, true, &configuration->latestRecordingTime);
+
+        }
+
+        if (success == false) fprintf(stderr, "Could not parse \"%s\" in %s.\n", key, filename);
+
+    }
+
+    fclose(file);
+
+    if (success && foundSampleRate == false) {
+
+        fprintf(stderr, "No sample rate found in %s.\n", filename);
+
+        success = false;
+
+    }
+
+    /* The periods are listed from the earliest local start time, while the firmware stores them in UTC order */
+
+    qsort(configuration->recordingPeriods, configuration->activeRecordingPeriods, sizeof(SC_recordingPeriod_t), compareRecordingPeriods);
+
+    return success;
+
+}
+
+/* Function to record a simulated file */
+
+static void addRecording(configuration_t *configuration, projection_t *projection, uint32_t step, uint32_t gain, uint32_t startTime, uint32_t duration, bool extendedOutput, uint32_t clusterSize) {
+
+    uint64_t numberOfBytes = extendedOutput ? EXTENDED_WAV_HEADER_SIZE + (uint64_t)NUMBER_OF_BYTES_IN_EXTENDED_SAMPLE * configuration->sampleRate * duration : WAV_HEADER_SIZE + (uint64_t)NUMBER_OF_BYTES_IN_SAMPLE * configuration->sampleRate * duration;
+
+    projection->numberOfFiles += 1;
+
+    projection->numberOfBytes += numberOfBytes;
+
+    projection->numberOfBytesOnCard += ROUND_UP_TO_MULTIPLE(numberOfBytes, (uint64_t)clusterSize);
+
+    projection->recordingSeconds += duration;
+
+    /* The file name is in local time as on the device */
+
+    struct tm time;
+
+    time_t rawTime = startTime;
+
+    gmtime_r(&rawTime, &time);
+
+    printf("%u,%s,%04d-%02d-%02d %02d:%02d:%02d,%u,%lu,", step + 1, gainSettings[gain], 1900 + time.tm_year, 1 + time.tm_mon, time.tm_mday, time.tm_hour, time.tm_min, time.tm_sec, duration, (unsigned long)numberOfBytes);
+
+    rawTime = startTime + configuration->timezoneMinutes * SECONDS_IN_MINUTE;
+
+    gmtime_r(&rawTime, &time);
+
+    printf("%04d%02d%02d_%02d%02d%02d_gain%s.WAV\n", 1900 + time.tm_year, 1 + time.tm_mon, time.tm_mday, time.tm_hour, time.tm_min, time.tm_sec, filenameGainSettings[gain]);
+
+}
+
+/* Usage message */
+
+static void printUsage(char *program) {
+
+    fprintf(stderr, "Usage: %s [-t start date YYYY-MM-DD] [-d days] [-p preparation period ms] [-k cluster size bytes] [-x] [-s sleep current uA] [-a awake current mA] [-r recording current mA] [-b battery capacity mAh] CONFIG.TXT\n", program);
+
+    fprintf(stderr, "Simulates the CUSTOM mode schedule of a CONFIG.TXT written by the firmware. Each recording is written to stdout as CSV and the storage and energy projection to stderr. Use -x for 24-bit output.\n");
+
+}
+
+/* Main function */
+
+int main(int argc, char **argv) {
+
+    uint32_t startTime = 0;
+
+    uint32_t numberOfDays = DEFAULT_SIMULATION_DAYS;
+
+    uint32_t preparationPeriod = DEFAULT_PREPARATION_PERIOD;
+
+    uint32_t clusterSize = DEFAULT_CLUSTER_SIZE;
+
+    bool extendedOutput = false;
+
+    double sleepCurrent = DEFAULT_SLEEP_CURRENT_UA;
+
+    double awakeCurrent = DEFAULT_AWAKE_CURRENT_MA;
+
+    double recordingCurrent = DEFAULT_RECORDING_CURRENT_MA;
+
+    double batteryCapacity = DEFAULT_BATTERY_CAPACITY_MAH;
+
+    int option;
+
+    while ((option = getopt(argc, argv, "t:d:p:k:xs:a:r:b:h")) != -1) {
+
+        if (option == 't') {
+
+            if (parseDateTime(optarg, 0, false, &startTime) == false) {
+
+                printUsage(argv[0]);
+
+                return EXIT_FAILURE;
+
+            }
+
+        } else if (option == 'd') {
+
+            numberOfDays = atoi(optarg);
+
+        } else if (option == 'p') {
+
+            preparationPeriod = atoi(optarg);
+
+        } else if (option == 'k') {
+
+            clusterSize = atoi(optarg);
+
+        } else if (option == 'x') {
+
+            extendedOutput = true;
+
+        } else if (option == 's') {
+
+            sleepCurrent = atof(optarg);
+
+        } else if (option == 'a') {
+
+            awakeCurrent = atof(optarg);
+
+        } else if (option == 'r') {
+
+            recordingCurrent = atof(optarg);
+
+        } else if (option == 'b') {
+
+            batteryCapacity = atof(optarg);
+
+        } else {
+
+            printUsage(argv[0]);
+
+            return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+
+        }
+
+    }
+
+    if (optind >= argc || numberOfDays == 0 || clusterSize == 0 || (clusterSize & (clusterSize - 1))) {
+
+        printUsage(argv[0]);
+
+        return EXIT_FAILURE;
+
+    }
+
+    /* Read the configuration */
+
+    static configuration_t configuration;
+
+    if (readConfiguration(argv[optind], &configuration) == false) {
+
+        fprintf(stderr, "Could not read configuration file %s.\n", argv[optind]);
+
+        return EXIT_FAILURE;
+
+    }
+
+    /* Start at the first recording date, or today, if no start date is given */
+
+    if (startTime == 0) {
+
+        startTime = configuration.earliestRecordingTime > 0 ? configuration.earliestRecordingTime : time(NULL);
+
+        startTime -= startTime % SECONDS_IN_DAY;
+
+    }
+
+    uint32_t endTime = startTime + numberOfDays * SECONDS_IN_DAY;
+
+    /* Compile the timeline as the firmware does on switching to CUSTOM */
+
+    SC_settings_t settings = {
+        .recordDurationGain1 = configuration.recordDurationGain1,
+        .sleepDurationBetweenGains = configuration.sleepDurationBetweenGains,
+        .recordDurationGain2 = configuration.recordDurationGain2,
+        .sleepDuration = configuration.sleepDuration,
+        .disableSleepRecordCycle = configuration.disableSleepRecordCycle,
+        .earliestRecordingTime = configuration.earliestRecordingTime,
+        .latestRecordingTime = configuration.latestRecordingTime,
+        .activeRecordingPeriods = configuration.activeRecordingPeriods,
+        .recordingPeriods = configuration.recordingPeriods
+    };
+
+    Schedule_setAdditionalGainSteps(&settings, configuration.additionalGainSteps, configuration.numberOfAdditionalGainSteps);
+
+    static SC_timeline_t timeline;
+
+    Schedule_compileTimeline(&settings, &timeline);
+
+    /* Run the schedule as the main loop does, one wake-up per gain1 recording */
+
+    static projection_t projection;
+
+    uint32_t preparationSeconds = ROUNDED_UP_DIV(preparationPeriod, MILLISECONDS_IN_SECOND);
+
+    uint32_t timeOfNextRecordingGain1, durationOfNextRecordingGain1, timeOfNextRecordingGain2, durationOfNextRecordingGain2;
+
+    Schedule_scheduleRecording(&settings, &timeline, startTime + preparationSeconds, &timeOfNextRecordingGain1, &durationOfNextRecordingGain1, &timeOfNextRecordingGain2, &durationOfNextRecordingGain2, NULL, NULL);
+
+    printf("Step,Gain,Start (UTC),Duration (s),Size (bytes),File\n");
+
+    while (timeOfNextRecordingGain1 < endTime) {
+
+        bool gain2RecordingFollows = timeOfNextRecordingGain2 <= timeOfNextRecordingGain1 + durationOfNextRecordingGain1 + configuration.sleepDurationBetweenGains + 1;
+
+        /* Build the sequence of recordings as the firmware does, with the additional steps found by the same schedule code */
+
+        SC_recordingStep_t steps[MAX_RECORDING_STEPS];
+
+        steps[0] = (SC_recordingStep_t){.time = timeOfNextRecordingGain1, .duration = durationOfNextRecordingGain1, .gain = configuration.gain1};
+
+        uint32_t numberOfSteps = 1;
+
+        if (gain2RecordingFollows) {
+
+            steps[1] = (SC_recordingStep_t){.time = timeOfNextRecordingGain2, .duration = durationOfNextRecordingGain2, .gain = configuration.gain2};
+
+            numberOfSteps = 2;
+
+            numberOfSteps += Schedule_getAdditionalRecordings(&settings, &timeline, timeOfNextRecordingGain1, timeOfNextRecordingGain2, durationOfNextRecordingGain2, steps + numberOfSteps);
+
+        }
+
+        /* The device sleeps in EM2 between the recordings so the gaps are counted as sleep. A step which starts before the previous one ends would share its samples, so it is reported */
+
+        for (uint32_t i = 0; i < numberOfSteps; i += 1) {
+
+            if (i > 0 && steps[i].time < steps[i - 1].time + steps[i - 1].duration) {
+
+                fprintf(stderr, "Step %u at %u starts before step %u ends at %u.\n", i + 1, steps[i].time, i, steps[i - 1].time + steps[i - 1].duration);
+
+                projection.numberOfOverlappingSteps += 1;
+
+            }
+
+            addRecording(&configuration, &projection, i, steps[i].gain, steps[i].time, steps[i].duration, extendedOutput, clusterSize);
+
+        }
+
+        uint32_t endOfRecording = steps[numberOfSteps - 1].time + steps[numberOfSteps - 1].duration;
+
+        projection.awakeSeconds += preparationSeconds;
+
+        uint32_t scheduleTime = MAX(endOfRecording + preparationSeconds, timeOfNextRecordingGain2 + durationOfNextRecordingGain2);
+
+        Schedule_scheduleRecording(&settings, &timeline, scheduleTime, &timeOfNextRecordingGain1, &durationOfNextRecordingGain1, &timeOfNextRecordingGain2, &durationOfNextRecordingGain2, NULL, NULL);
+
+    }
+
+    /* Report the projection */
+
+    projection.totalSeconds = (uint64_t)numberOfDays * SECONDS_IN_DAY;
+
+    uint64_t sleepSeconds = projection.totalSeconds - MIN(projection.totalSeconds, projection.recordingSeconds + projection.awakeSeconds);
+
+    double energy = (sleepCurrent / 1000.0 * sleepSeconds + awakeCurrent * projection.awakeSeconds + recordingCurrent * projection.recordingSeconds) / SECONDS_IN_HOUR;
+
+    double averageCurrent = energy * SECONDS_IN_HOUR / projection.totalSeconds;
+
+    fprintf(stderr, "Simulated days         : %u\n", numberOfDays);
+
+    fprintf(stderr, "Files                  : %u\n", projection.numberOfFiles);
+
+    fprintf(stderr, "Recorded data (GB)     : %.3f\n", projection.numberOfBytes / 1e9);
+
+    fprintf(stderr, "Space on card (GB)     : %.3f (%u byte clusters)\n", projection.numberOfBytesOnCard / 1e9, clusterSize);
+
+    fprintf(stderr, "Recording (hours)      : %.2f\n", projection.recordingSeconds / (double)SECONDS_IN_HOUR);
+
+    fprintf(stderr, "Awake (hours)          : %.2f\n", projection.awakeSeconds / (double)SECONDS_IN_HOUR);
+
+    fprintf(stderr, "Energy (mAh)           : %.1f\n", energy);
+
+    fprintf(stderr, "Average current (mA)   : %.3f\n", averageCurrent);
+
+    if (averageCurrent > 0.0) fprintf(stderr, "Battery life (days)    : %.1f (%.0f mAh)\n", batteryCapacity / averageCurrent / 24.0, batteryCapacity);
+
+    fprintf(stderr, "Overlapping steps      : %u\n", projection.numberOfOverlappingSteps);
+
+    return projection.numberOfOverlappingSteps > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+
+}
@@ -26,6 +26,8 @@
 
 #define PULSE_INTERVAL                      4096
 
+#define SAMPLE_BLOCK_SIZE                   16
+
 #define MAXIMUM_NUMBER_OF_BYTES             16
 #define RECEIVE_BUFFER_SIZE_IN_BYTES        16
 
@@ -138,9 +140,9 @@ static const uint8_t hammingConversion[128] = { 0,  0,  0,  1,  0,  1,  1,  1, \
 
 /* Filter variables */
 
-static BW_filter_t agcFilter;
+static BQ_cascade_t agcFilter;
 
-static BW_filter_t carrierFilter;
+static BQ_cascade_t carrierFilter;
 
 static BQ_filter_t channel1Filter;
 
@@ -148,9 +150,9 @@ static BQ_filter_t channel2Filter;
 
 /* Filter coefficient variables */
 
-static BW_filterCoefficients_t agcFilterCoefficients;
+static BQ_filterCoefficients_t agcFilterCoefficients;
 
-static BW_filterCoefficients_t carrierFilterCoefficients;
+static BQ_filterCoefficients_t carrierFilterCoefficients;
 
 static BQ_filterCoefficients_t channelFilterCoefficients;
 
@@ -162,9 +164,25 @@ static float omegaT = 0.0f;
 
 static volatile bool cancel;
 
-static volatile int16_t configSample;
+static int16_t configSamples[2][SAMPLE_BLOCK_SIZE];
+
+static volatile uint32_t configSampleIndex;
+
+static volatile uint32_t configBlockIndex;
+
+static volatile uint32_t configBlockCount;
+
+/* Filtered sample variables */
+
+static uint32_t filteredBlockCount;
+
+static uint32_t numberOfDroppedBlocks;
+
+static float filteredSamples[SAMPLE_BLOCK_SIZE];
+
+static float agcSamples[SAMPLE_BLOCK_SIZE];
 
-static volatile bool configSampleReady;
+static uint32_t filteredSampleIndex;
 
 STATIC_UBUF(receivedBytes, RECEIVE_BUFFER_SIZE_IN_BYTES);
 
@@ -222,28 +240,94 @@ static inline bool checkCRC(const uint8_t *data, uint32_t size) {
 
 }
 
-/* Function to perform Costas loop */
+/* Functions to filter and regulate a block of samples */
+
+static void resetSampleBlocks() {
+
+    configSampleIndex = 0;
+
+    configBlockIndex = 0;
 
-static inline float updateCostasLoop(float sample) {
+    configBlockCount = 0;
 
-    /* Apply gain control */
+    filteredBlockCount = 0;
+
+    numberOfDroppedBlocks = 0;
+
+    filteredSampleIndex = SAMPLE_BLOCK_SIZE;
+
+}
 
-    float filteredSample = Butterworth_applyBandPassFilter(sample, &carrierFilter, &carrierFilterCoefficients);
+static inline bool getNextFilteredSample(float *sample) {
 
-    if (USE_AGC) {
+    if (filteredSampleIndex == SAMPLE_BLOCK_SIZE) {
 
-        float regulatedFilteredSample = filteredSample > 0.0f ? filteredSample : -filteredSample;
+        uint32_t blockCount = configBlockCount;
 
-        float agcOutput = Butterworth_applyLowPassFilter(regulatedFilteredSample, &agcFilter, &agcFilterCoefficients);
+        if (blockCount == filteredBlockCount) return false;
 
-        filteredSample /= MAX(agcOutput, AGC_MINIMUM_AMPLITUDE);
+        /* Blocks completed since the last one was taken have already been overwritten by the interrupt */
+
+        numberOfDroppedBlocks += blockCount - filteredBlockCount - 1;
+
+        filteredBlockCount = blockCount;
+
+        /* Filter the block that the interrupt has just completed */
+
+        Biquad_applyCascadeToSamples(&carrierFilter, configSamples[configBlockIndex ^ 1], filteredSamples, SAMPLE_BLOCK_SIZE);
+
+        /* Drop the block if the interrupt moved on to it while it was being filtered */
+
+        if (configBlockCount != blockCount) {
+
+            numberOfDroppedBlocks += 1;
+
+            return false;
+
+        }
+
+        /* Apply gain control */
+
+        if (USE_AGC) {
+
+            for (uint32_t i = 0; i < SAMPLE_BLOCK_SIZE; i += 1) {
+
+                agcSamples[i] = filteredSamples[i] > 0.0f ? filteredSamples[i] : -filteredSamples[i];
+
+            }
 
-    } else {
+            Biquad_applyCascade(&agcFilter, agcSamples, agcSamples, SAMPLE_BLOCK_SIZE);
 
-        filteredSample /= MANUAL_GAIN_DIVISOR;
+            for (uint32_t i = 0; i < SAMPLE_BLOCK_SIZE; i += 1) {
+
+                filteredSamples[i] /= MAX(agcSamples[i], AGC_MINIMUM_AMPLITUDE);
+
+            }
+
+        } else {
+
+            for (uint32_t i = 0; i < SAMPLE_BLOCK_SIZE; i += 1) {
+
+                filteredSamples[i] /= MANUAL_GAIN_DIVISOR;
+
+            }
+
+        }
+
+        filteredSampleIndex = 0;
 
     }
 
+    *sample = filteredSamples[filteredSampleIndex++];
+
+    return true;
+
+}
+
+/* Function to perform Costas loop */
+
+static inline float updateCostasLoop(float filteredSample) {
+
     /* Demodulate input sound */
 
     uint8_t index = (uint32_t)omegaT & (SINE_TABLE_LENGTH - 1);
@@ -274,14 +358,28 @@ static inline float updateCostasLoop(float sample) {
 
 inline void AudioMoth_handleMicrophoneInterrupt(int16_t sample) {
 
-    configSampleReady = true;
+    configSamples[configBlockIndex][configSampleIndex++] = sample;
+
+    if (configSampleIndex == SAMPLE_BLOCK_SIZE) {
+
+        configSampleIndex = 0;
 
-    configSample = sample;
+        configBlockIndex ^= 1;
+
+        configBlockCount += 1;
+
+    }
 
 }
 
 /* Functions to handle audio configuration */
 
+uint32_t AudioConfig_getNumberOfDroppedBlocks() {
+
+    return numberOfDroppedBlocks;
+
+}
+
 void AudioConfig_enableAudioConfiguration() {
 
     /* Initialise microphone for configuration */
@@ -292,17 +390,17 @@ void AudioConfig_enableAudioConfiguration() {
 
     /* Design filters */
 
-    Butterworth_designBandPassFilter(&carrierFilterCoefficients, CONFIG_SAMPLE_RATE, CONFIG_CARRIER_FREQUENCY - CARRIER_FILTER_CUTOFF_FREQUENCY, CONFIG_CARRIER_FREQUENCY + CARRIER_FILTER_CUTOFF_FREQUENCY);
+    Butterworth_designBandPassBiquad(&carrierFilterCoefficients, CONFIG_SAMPLE_RATE, CONFIG_CARRIER_FREQUENCY - CARRIER_FILTER_CUTOFF_FREQUENCY, CONFIG_CARRIER_FREQUENCY + CARRIER_FILTER_CUTOFF_FREQUENCY);
 
-    if (USE_AGC) Butterworth_designLowPassFilter(&agcFilterCoefficients, CONFIG_SAMPLE_RATE, SPEED_FACTOR * AGC_FILTER_CUTOFF_FREQUENCY);
+    if (USE_AGC) Butterworth_designLowPassBiquad(&agcFilterCoefficients, CONFIG_SAMPLE_RATE, SPEED_FACTOR * AGC_FILTER_CUTOFF_FREQUENCY);
 
     Biquad_designLowPassFilter(&channelFilterCoefficients, CONFIG_SAMPLE_RATE, SPEED_FACTOR * CHANNEL_FILTER_CUTOFF_FREQUENCY, CHANNEL_FILTER_BANDWIDTH);
 
     /* Initialise filters */
 
-    Butterworth_initialise(&carrierFilter);
+    Biquad_initialiseCascade(&carrierFilter, &carrierFilterCoefficients, 1);
 
-    if (USE_AGC) Butterworth_initialise(&agcFilter);
+    if (USE_AGC) Biquad_initialiseCascade(&agcFilter, &agcFilterCoefficients, 1);
 
     Biquad_initialise(&channel1Filter);
 
@@ -326,7 +424,7 @@ bool AudioConfig_listenForAudioConfigurationTone(uint32_t milliseconds) {
 
     cancel = false;
 
-    configSampleReady = false;
+    resetSampleBlocks();
 
     /* Zero crossing variables */
 
@@ -350,11 +448,11 @@ bool AudioConfig_listenForAudioConfigurationTone(uint32_t milliseconds) {
 
     while (cancel == false && counter < maximumCounter) {
 
-        if (configSampleReady) {
+        float sample;
 
-            /* Update the Costas loop with new sample */
+        if (getNextFilteredSample(&sample)) {
 
-            float sample = (float)configSample;
+            /* Update the Costas loop with new sample, inverting after the linear filters and gain control */
 
             if (hasInvertedOutput) sample = -sample;
 
@@ -390,8 +488,6 @@ bool AudioConfig_listenForAudioConfigurationTone(uint32_t milliseconds) {
 
             lastValue = costasLoopOutput;
 
-            configSampleReady = false;
-
             counter += 1;
 
         }
@@ -408,7 +504,7 @@ bool AudioConfig_listenForAudioConfigurationPackets(bool timeout, uint32_t milli
 
     cancel = false;
 
-    configSampleReady = false;
+    resetSampleBlocks();
 
     /* Zero crossing variables */
 
@@ -436,7 +532,9 @@ bool AudioConfig_listenForAudioConfigurationPackets(bool timeout, uint32_t milli
 
     while (cancel == false && (timeout == false || counter < maximumCounter)) {
 
-        if (configSampleReady) {
+        float sample;
+
+        if (getNextFilteredSample(&sample)) {
 
             /* Call pulse handler */
 
@@ -444,7 +542,7 @@ bool AudioConfig_listenForAudioConfigurationPackets(bool timeout, uint32_t milli
 
             /* Update the Costas loop with new sample */
 
-            float costasLoopOutput = updateCostasLoop((float)configSample);
+            float costasLoopOutput = updateCostasLoop(sample);
 
             /* Check thresholds */
 
@@ -624,8 +722,6 @@ bool AudioConfig_listenForAudioConfigurationPackets(bool timeout, uint32_t milli
 
             lastValue = costasLoopOutput;
 
-            configSampleReady = false;
-
             counter += 1;
 
         }
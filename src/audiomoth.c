@@ -51,6 +51,14 @@
 #define MILLISECONDS_IN_SECOND                    1000
 #define SECONDS_IN_MINUTE                         60
 
+/* Delay constants */
+
+#define AM_DELAY_TIMER_MAXIMUM_PERIOD             1000
+#define AM_DELAY_MINIMUM_DEEP_SLEEP_PERIOD        20
+#define AM_DELAY_WAKE_UP_ALLOWANCE                5
+#define AM_DELAY_MINIMUM_COMPARE_TICKS            8
+#define AM_DELAY_MAXIMUM_COMPARE_TICKS            (16 * AM_BURTC_TICKS_PER_SECOND)
+
 /* USB EM2 wake constant */
 
 #define AM_USB_EM2_RTC_WAKEUP_INTERVAL            10
@@ -95,6 +103,18 @@
 #define AM_BURTC_TOTAL_REGISTERS                  128
 #define AM_BURTC_RESERVED_REGISTERS               8
 
+/* The file system cache uses the last registers so the application backup domain keeps its layout */
+
+#define AM_BURTC_FILE_SYSTEM_REGISTERS            3
+#define AM_BURTC_FILE_SYSTEM_FINGERPRINT          (AM_BURTC_TOTAL_REGISTERS - 3)
+#define AM_BURTC_FILE_SYSTEM_LAST_CLUSTER         (AM_BURTC_TOTAL_REGISTERS - 2)
+#define AM_BURTC_FILE_SYSTEM_FREE_CLUSTERS        (AM_BURTC_TOTAL_REGISTERS - 1)
+
+/* File system cache constants */
+
+#define AM_FILE_SYSTEM_UNKNOWN_CLUSTER            0xFFFFFFFF
+#define AM_FILE_SYSTEM_FINGERPRINT_MULTIPLIER     0x01000193
+
 /* USB message types */
 
 #define AM_USB_BUFFERSIZE                         64
@@ -174,7 +194,10 @@ STATIC_UBUF(transmitBuffer, 2 * AM_USB_BUFFERSIZE);
 /* SD card variables */
 
 static FATFS fatfs;
-static FIL file;
+static FIL files[AM_NUMBER_OF_FILES];
+static FIL *fileHandles[AM_NUMBER_OF_FILES] = {files, files + 1, files + 2};
+static AM_file_t currentFile = AM_PRIMARY_FILE;
+static FIL *file = files;
 static UINT bw;
 
 /* DMA variables */
@@ -182,10 +205,16 @@ static UINT bw;
 static DMA_CB_TypeDef cb;
 static uint16_t numberOfSamplesPerTransfer;
 
-/* Delay timer variable */
+/* Microphone variables */
+
+static bool microphoneEnabled;
+
+/* Delay timer variables */
 
 static volatile bool delayTimmerRunning;
 
+static bool backupRTCRunning;
+
 /* USB bootloader variables */
 
 static volatile uint16_t currentCRC;
@@ -213,6 +242,9 @@ static void setupOpAmp(AM_gainRange_t gainRain, AM_gainSetting_t gain);
 static AM_hardwareVersion_t senseHardwareVersion(void);
 static void enablePrsTimer(uint32_t samplerate);
 static void setupADC(uint32_t clockDivider, uint32_t acquisitionCycles, uint32_t oversampleRate);
+static void storeFileSystemAllocationState(void);
+static void timerDelay(uint32_t milliseconds);
+static void deepSleepDelay(uint32_t ticks);
 
 /* Function to initialise the main components */
 
@@ -328,6 +360,10 @@ void AudioMoth_initialise() {
 
         BURTC_RetRegSet(AM_BURTC_TIME_OFFSET_HIGH, 0);
 
+        /* Clear the file system cache */
+
+        AudioMoth_clearFileSystemCache();
+
         /* Set the initial power up flag */
 
         BURTC_RetRegSet(AM_BURTC_INITIAL_POWER_UP_FLAG,  AM_BURTC_CANARY_VALUE);
@@ -348,6 +384,10 @@ void AudioMoth_initialise() {
 
     }
 
+    /* The BURTC is now counting so long delays can be spent in EM2 */
+
+    backupRTCRunning = true;
+
     /* If this was a watch dog timer reset then record that this occurred */
 
     if (resetCause & RMU_RSTCAUSE_WDOGRST) {
@@ -545,6 +585,14 @@ void TIMER1_IRQHandler(void) {
 
 }
 
+void BURTC_IRQHandler(void) {
+
+    /* Only the compare interrupt is cleared as the overflow flag is polled when reading the time */
+
+    if (BURTC_IntGet() & BURTC_IF_COMP0) BURTC_IntClear(BURTC_IF_COMP0);
+
+}
+
 static void transferComplete(unsigned int channel, bool isPrimaryBuffer, void *user) {
 
     int16_t *nextBuffer = NULL;
@@ -766,12 +814,26 @@ bool AudioMoth_enableMicrophone(AM_gainRange_t gainRain, AM_gainSetting_t gain,
 
     setupADC(clockDivider, acquisitionCycles, oversampleRate);
 
+    microphoneEnabled = true;
+
     return externalMicrophone;
 
 }
 
+void AudioMoth_setMicrophoneGain(AM_gainRange_t gainRange, AM_gainSetting_t gain) {
+
+    /* Change the amplifier gain without interrupting the ADC or DMA transfers */
+
+    setupOpAmp(gainRange, gain);
+
+}
+
 void AudioMoth_disableMicrophone(void) {
 
+    if (microphoneEnabled == false) return;
+
+    microphoneEnabled = false;
+
     /* Check the hardware version */
 
     AM_hardwareVersion_t hardwareVersion = BURTC_RetRegGet(AM_BURTC_HARDWARE_VERSION);
@@ -1048,15 +1110,9 @@ static void setupADC(uint32_t clockDivider, uint32_t acquisitionCycles, uint32_t
 
 }
 
-/* Function to implement a sleeping delay */
-
-void AudioMoth_delay(uint32_t milliseconds) {
-
-    /* Ensure the delay period wont cause the counter to overflow and calculate clock ticks to wait */
-
-    if (milliseconds == 0)  return;
+/* Functions to implement a sleeping delay */
 
-    if (milliseconds > MILLISECONDS_IN_SECOND) milliseconds = MILLISECONDS_IN_SECOND;
+static void timerDelay(uint32_t milliseconds) {
 
     /* Enable clock for TIMER1 */
 
@@ -1072,7 +1128,7 @@ void AudioMoth_delay(uint32_t milliseconds) {
 
     TIMER_Init(TIMER1, &delayInit);
 
-    /* Set up interrupt and set top */
+    /* Set up interrupt */
 
     TIMER_IntEnable(TIMER1, TIMER_IF_OF);
 
@@ -1080,21 +1136,35 @@ void AudioMoth_delay(uint32_t milliseconds) {
 
     NVIC_EnableIRQ(TIMER1_IRQn);
 
-    /* Start timer and wait until interrupt occurs */
+    /* Chain overflows, each short enough not to overflow the 16-bit counter, until the delay is complete */
 
-    delayTimmerRunning = true;
+    uint32_t clockTicksPerSecond = CMU_ClockFreqGet(cmuClock_HF) >> timerPrescale1024;
 
-    uint32_t clockTicksToWait = ROUNDED_DIV((CMU_ClockFreqGet(cmuClock_HF) >> timerPrescale1024) * milliseconds, MILLISECONDS_IN_SECOND);
+    while (milliseconds > 0) {
 
-    TIMER_TopSet(TIMER1, clockTicksToWait);
+        uint32_t period = MIN(milliseconds, AM_DELAY_TIMER_MAXIMUM_PERIOD);
 
-    TIMER_CounterSet(TIMER1, 0);
+        milliseconds -= period;
 
-    TIMER_Enable(TIMER1, true);
+        /* Start timer and wait until interrupt occurs */
 
-    while (delayTimmerRunning) {
+        delayTimmerRunning = true;
 
-        EMU_EnterEM1();
+        uint32_t clockTicksToWait = ROUNDED_DIV(clockTicksPerSecond * period, MILLISECONDS_IN_SECOND);
+
+        TIMER_TopSet(TIMER1, clockTicksToWait);
+
+        TIMER_CounterSet(TIMER1, 0);
+
+        TIMER_Enable(TIMER1, true);
+
+        while (delayTimmerRunning) {
+
+            EMU_EnterEM1();
+
+        }
+
+        TIMER_Enable(TIMER1, false);
 
     }
 
@@ -1112,6 +1182,88 @@ void AudioMoth_delay(uint32_t milliseconds) {
 
 }
 
+static void deepSleepDelay(uint32_t ticks) {
+
+    /* Mask the overflow interrupt, which is polled, and enable the BURTC interrupt to wake from EM2 */
+
+    BURTC_IntDisable(BURTC_IF_OF);
+
+    BURTC_IntClear(BURTC_IF_COMP0);
+
+    NVIC_ClearPendingIRQ(BURTC_IRQn);
+
+    NVIC_EnableIRQ(BURTC_IRQn);
+
+    /* Chain compares, feeding the watch dog timer on each, until the delay is complete. A short remainder is merged so the compare is never set behind the counter */
+
+    uint32_t counterValueToMatch = BURTC_CounterGet();
+
+    while (ticks > 0) {
+
+        uint32_t period = MIN(ticks, AM_DELAY_MAXIMUM_COMPARE_TICKS);
+
+        if (ticks - period < AM_DELAY_MINIMUM_COMPARE_TICKS) period = ticks;
+
+        ticks -= period;
+
+        counterValueToMatch += period;
+
+        BURTC_CompareSet(0, counterValueToMatch);
+
+        BURTC_IntEnable(BURTC_IF_COMP0);
+
+        /* Other interrupts, such as a switch change, also wake the processor so sleep until the counter has reached the compare value */
+
+        while ((int32_t)(counterValueToMatch - BURTC_CounterGet()) > 0) {
+
+            EMU_EnterEM2(true);
+
+        }
+
+        WDOG_Feed();
+
+    }
+
+    /* Disable the compare interrupt and restore the overflow interrupt for EM4 */
+
+    BURTC_IntDisable(BURTC_IF_COMP0);
+
+    BURTC_IntClear(BURTC_IF_COMP0);
+
+    NVIC_DisableIRQ(BURTC_IRQn);
+
+    NVIC_ClearPendingIRQ(BURTC_IRQn);
+
+    BURTC_IntEnable(BURTC_IF_OF);
+
+}
+
+void AudioMoth_delay(uint32_t milliseconds) {
+
+    if (milliseconds == 0) return;
+
+    /* Spend most of a long delay in EM2 on the BURTC and finish on TIMER1 for millisecond precision. The time spent waking, including the HFXO start up, is measured and removed. The ADC and DMA transfers stop in EM2 so the whole delay is spent in EM1 while the microphone is enabled */
+
+    if (backupRTCRunning && microphoneEnabled == false && milliseconds >= AM_DELAY_MINIMUM_DEEP_SLEEP_PERIOD) {
+
+        uint32_t startCounterValue = BURTC_CounterGet();
+
+        uint32_t ticks = (uint64_t)(milliseconds - AM_DELAY_WAKE_UP_ALLOWANCE) * AM_BURTC_TICKS_PER_SECOND / MILLISECONDS_IN_SECOND;
+
+        deepSleepDelay(ticks);
+
+        uint32_t elapsedTicks = BURTC_CounterGet() - startCounterValue;
+
+        uint32_t elapsedMilliseconds = ROUNDED_DIV((uint64_t)elapsedTicks * MILLISECONDS_IN_SECOND, AM_BURTC_TICKS_PER_SECOND);
+
+        milliseconds = elapsedMilliseconds >= milliseconds ? 0 : milliseconds - elapsedMilliseconds;
+
+    }
+
+    if (milliseconds > 0) timerDelay(milliseconds);
+
+}
+
 void AudioMoth_sleep(void) {
 
     EMU_EnterEM1();
@@ -1128,6 +1280,10 @@ void AudioMoth_deepSleep(void) {
 
 void AudioMoth_powerDown() {
 
+    /* Keep the file system allocation state */
+
+    storeFileSystemAllocationState();
+
     /* Set up GPIO pins */
 
     setupGPIO();
@@ -1170,6 +1326,10 @@ void AudioMoth_resetInterrupt(uint32_t milliseconds) {
 
 void AudioMoth_powerDownAndWakeMilliseconds(uint32_t milliseconds) {
 
+    /* Keep the file system allocation state */
+
+    storeFileSystemAllocationState();
+
     /* Put GPIO pins in power down state */
 
     setupGPIO();
@@ -1212,6 +1372,10 @@ void AudioMoth_powerDownAndWake(uint32_t seconds, bool synchronised) {
 
     } else {
 
+        /* Keep the file system allocation state */
+
+        storeFileSystemAllocationState();
+
         /* Put GPIO pins in power down state */
 
         setupGPIO();
@@ -2329,7 +2493,7 @@ AM_switchPosition_t AudioMoth_getSwitchPosition(void) {
 
 void AudioMoth_storeInBackupDomain(uint32_t number, uint32_t data) {
 
-    if (number < AM_BURTC_TOTAL_REGISTERS - AM_BURTC_RESERVED_REGISTERS) {
+    if (number < AM_BURTC_TOTAL_REGISTERS - AM_BURTC_RESERVED_REGISTERS - AM_BURTC_FILE_SYSTEM_REGISTERS) {
 
         BURTC_RetRegSet(AM_BURTC_RESERVED_REGISTERS + number, data);
 
@@ -2339,7 +2503,7 @@ void AudioMoth_storeInBackupDomain(uint32_t number, uint32_t data) {
 
 uint32_t AudioMoth_retreiveFromBackupDomain(uint32_t number) {
 
-    if (number < AM_BURTC_TOTAL_REGISTERS - AM_BURTC_RESERVED_REGISTERS) {
+    if (number < AM_BURTC_TOTAL_REGISTERS - AM_BURTC_RESERVED_REGISTERS - AM_BURTC_FILE_SYSTEM_REGISTERS) {
 
         return BURTC_RetRegGet(AM_BURTC_RESERVED_REGISTERS + number);
 
@@ -2555,7 +2719,7 @@ void AudioMoth_startRealTimeClockMilliseconds(uint32_t milliseconds) {
 
     if (milliseconds == 0) return;
 
-    if (milliseconds > MILLISECONDS_IN_SECOND) milliseconds = MILLISECONDS_IN_SECOND;
+    if (milliseconds > SECONDS_IN_MINUTE * MILLISECONDS_IN_SECOND) milliseconds = SECONDS_IN_MINUTE * MILLISECONDS_IN_SECOND;
 
     uint32_t ticks = ROUNDED_DIV(milliseconds * AM_LFXO_LFRCO_TICKS_PER_SECOND, MILLISECONDS_IN_SECOND);
 
@@ -2650,6 +2814,58 @@ void AudioMoth_setGreenLED(bool state) {
 
 /* Functions to handle file system */
 
+static uint32_t calculateFileSystemFingerprint(void) {
+
+    /* Combine the volume geometry so a cache from a different or reformatted volume layout is not used */
+
+    uint32_t values[] = {fatfs.fs_type, fatfs.csize, fatfs.n_fatent, fatfs.fsize, fatfs.volbase, fatfs.fatbase, fatfs.dirbase, fatfs.database};
+
+    uint32_t fingerprint = AM_BURTC_CANARY_VALUE;
+
+    for (uint32_t i = 0; i < sizeof(values) / sizeof(uint32_t); i += 1) {
+
+        fingerprint = (fingerprint ^ values[i]) * AM_FILE_SYSTEM_FINGERPRINT_MULTIPLIER;
+
+    }
+
+    return fingerprint;
+
+}
+
+static void restoreFileSystemAllocationState(void) {
+
+    if (BURTC_RetRegGet(AM_BURTC_FILE_SYSTEM_FINGERPRINT) != calculateFileSystemFingerprint()) return;
+
+    /* Only fill in what the mount could not read from the volume, as on exFAT which has no FSINFO sector */
+
+    uint32_t lastCluster = BURTC_RetRegGet(AM_BURTC_FILE_SYSTEM_LAST_CLUSTER);
+
+    uint32_t freeClusters = BURTC_RetRegGet(AM_BURTC_FILE_SYSTEM_FREE_CLUSTERS);
+
+    if (fatfs.last_clst == AM_FILE_SYSTEM_UNKNOWN_CLUSTER && lastCluster >= 2 && lastCluster < fatfs.n_fatent) fatfs.last_clst = lastCluster;
+
+    if (fatfs.free_clst == AM_FILE_SYSTEM_UNKNOWN_CLUSTER && freeClusters > 0 && freeClusters <= fatfs.n_fatent - 2) fatfs.free_clst = freeClusters;
+
+}
+
+static void storeFileSystemAllocationState(void) {
+
+    if (fatfs.fs_type == 0) return;
+
+    BURTC_RetRegSet(AM_BURTC_FILE_SYSTEM_FINGERPRINT, calculateFileSystemFingerprint());
+
+    BURTC_RetRegSet(AM_BURTC_FILE_SYSTEM_LAST_CLUSTER, fatfs.last_clst);
+
+    BURTC_RetRegSet(AM_BURTC_FILE_SYSTEM_FREE_CLUSTERS, fatfs.free_clst);
+
+}
+
+void AudioMoth_clearFileSystemCache(void) {
+
+    BURTC_RetRegSet(AM_BURTC_FILE_SYSTEM_FINGERPRINT, 0);
+
+}
+
 bool AudioMoth_enableFileSystem(AM_sdCardSpeed_t speed) {
 
     /* Check hardware version */
@@ -2682,6 +2898,10 @@ bool AudioMoth_enableFileSystem(AM_sdCardSpeed_t speed) {
         return false;
     }
 
+    /* Restore the allocation state kept from before the last power down so the allocation bitmap is not scanned from the start */
+
+    restoreFileSystemAllocationState();
+
     /* Return success */
 
     return true;
@@ -2706,6 +2926,30 @@ void AudioMoth_disableFileSystem(void) {
 
 }
 
+void AudioMoth_selectFile(AM_file_t selectedFile) {
+
+    /* Subsequent file operations act on the selected file */
+
+    currentFile = selectedFile;
+
+    file = fileHandles[selectedFile];
+
+}
+
+void AudioMoth_swapFiles(AM_file_t firstFile, AM_file_t secondFile) {
+
+    /* Exchange the open files behind the two selections so a file opened in advance can take over without being reopened */
+
+    FIL *temp = fileHandles[firstFile];
+
+    fileHandles[firstFile] = fileHandles[secondFile];
+
+    fileHandles[secondFile] = temp;
+
+    file = fileHandles[currentFile];
+
+}
+
 bool AudioMoth_doesFileExist(char *filename){
 
     FRESULT res = f_stat(filename, NULL);
@@ -2722,7 +2966,7 @@ bool AudioMoth_openFile(char *filename) {
 
     /* Open a file for writing. Overwrite existing file with the same name */
 
-    FRESULT res = f_open(&file, filename,  FA_CREATE_ALWAYS | FA_WRITE | FA_READ);
+    FRESULT res = f_open(file, filename,  FA_CREATE_ALWAYS | FA_WRITE | FA_READ);
 
     if (res != FR_OK) {
         return false;
@@ -2736,16 +2980,16 @@ bool AudioMoth_appendFile(char *filename) {
 
     /* Open the file for writing. Append existing file with the same name */
 
-    FRESULT res = f_open(&file, filename,  FA_OPEN_ALWAYS | FA_WRITE | FA_READ);
+    FRESULT res = f_open(file, filename,  FA_OPEN_ALWAYS | FA_WRITE | FA_READ);
 
     if (res != FR_OK) {
         return false;
     }
 
-    res = f_lseek(&file, f_size(&file));
+    res = f_lseek(file, f_size(file));
 
     if (res != FR_OK) {
-        f_close(&file);
+        f_close(file);
         return false;
     }
 
@@ -2755,7 +2999,7 @@ bool AudioMoth_appendFile(char *filename) {
 
 bool AudioMoth_openFileToRead(char *filename) {
 
-    FRESULT res = f_open(&file, filename,  FA_READ);
+    FRESULT res = f_open(file, filename,  FA_READ);
 
     if (res != FR_OK) {
         return false;
@@ -2767,7 +3011,7 @@ bool AudioMoth_openFileToRead(char *filename) {
 
 bool AudioMoth_readFile(char *buffer, uint32_t bufferSize) {
 
-    FRESULT res = f_read(&file, buffer, bufferSize, &bw);
+    FRESULT res = f_read(file, buffer, bufferSize, &bw);
 
     if (res != FR_OK) {
         return false;
@@ -2779,7 +3023,21 @@ bool AudioMoth_readFile(char *buffer, uint32_t bufferSize) {
 
 bool AudioMoth_seekInFile(uint32_t position) {
 
-    FRESULT res = f_lseek(&file, position);
+    FRESULT res = f_lseek(file, position);
+
+    if (res != FR_OK) {
+        return false;
+    }
+
+    return true;
+
+}
+
+bool AudioMoth_expandFile(uint32_t size) {
+
+    /* Allocate a contiguous block of clusters to an empty file */
+
+    FRESULT res = f_expand(file, size, 1);
 
     if (res != FR_OK) {
         return false;
@@ -2789,9 +3047,23 @@ bool AudioMoth_seekInFile(uint32_t position) {
 
 }
 
-bool AudioMoth_writeToFile(void *bytes, uint16_t bytesToWrite) {
+bool AudioMoth_truncateFile(void) {
+
+    /* Truncate the file at the current position */
 
-    FRESULT res = f_write(&file, bytes, bytesToWrite, &bw);
+    FRESULT res = f_truncate(file);
+
+    if (res != FR_OK) {
+        return false;
+    }
+
+    return true;
+
+}
+
+bool AudioMoth_writeToFile(void *bytes, uint32_t bytesToWrite) {
+
+    FRESULT res = f_write(file, bytes, bytesToWrite, &bw);
 
     if ((res != FR_OK) || (bytesToWrite != bw)) {
         return false;
@@ -2813,9 +3085,21 @@ bool AudioMoth_renameFile(char *originalFilename, char *newFilename) {
 
 }
 
+bool AudioMoth_deleteFile(char *filename) {
+
+    FRESULT res = f_unlink(filename);
+
+    if (res != FR_OK) {
+        return false;
+    }
+
+    return true;
+
+}
+
 bool AudioMoth_syncFile(void) {
 
-    FRESULT res = f_sync(&file);
+    FRESULT res = f_sync(file);
 
     if (res != FR_OK) {
         return false;
@@ -2827,7 +3111,7 @@ bool AudioMoth_syncFile(void) {
 
 bool AudioMoth_closeFile(void) {
 
-    FRESULT res = f_close(&file);
+    FRESULT res = f_close(file);
 
     if (res != FR_OK) {
         return false;
@@ -2837,6 +3121,20 @@ bool AudioMoth_closeFile(void) {
 
 }
 
+void AudioMoth_getSDCardBusyHistogram(uint32_t *histogram) {
+
+    /* Bin i counts card busy periods of [2^(i-1), 2^i) milliseconds */
+
+    MICROSD_GetBusyHistogram(histogram);
+
+}
+
+void AudioMoth_clearSDCardBusyHistogram(void) {
+
+    MICROSD_ClearBusyHistogram();
+
+}
+
 bool AudioMoth_doesDirectoryExist(char *folderName){
 
     FRESULT res = f_stat(folderName, NULL);
@@ -5,6 +5,7 @@
  *****************************************************************************/
 
 #include <math.h>
+#include <stddef.h>
 
 #include "biquad.h"
 
@@ -149,3 +150,83 @@ float Biquad_applyFilter(float sample, BQ_filter_t *filter, BQ_filterCoefficient
     return filter->yv[2];
 
 }
+
+/* Public functions to initialise and apply a cascade of second order sections to a block of samples */
+
+void Biquad_initialiseCascade(BQ_cascade_t *cascade, const BQ_filterCoefficients_t *coefficients, uint32_t numberOfSections) {
+
+    cascade->numberOfSections = numberOfSections < BQ_MAXIMUM_NUMBER_OF_SECTIONS ? numberOfSections : BQ_MAXIMUM_NUMBER_OF_SECTIONS;
+
+    cascade->coefficients = coefficients;
+
+    for (uint32_t i = 0; i < BQ_MAXIMUM_NUMBER_OF_SECTIONS; i += 1) {
+        cascade->state[i][0] = 0.0f;
+        cascade->state[i][1] = 0.0f;
+    }
+
+}
+
+static inline void applySection(float *state, const BQ_filterCoefficients_t *coefficients, const float *source, float *dest, uint32_t size) {
+
+    /* Transposed direct form II with the coefficients and state held in registers for the whole block */
+
+    float b0 = coefficients->B0_A0;
+    float b1 = coefficients->B1_A0;
+    float b2 = coefficients->B2_A0;
+    float a1 = coefficients->A1_A0;
+    float a2 = coefficients->A2_A0;
+
+    float z1 = state[0];
+    float z2 = state[1];
+
+    for (uint32_t i = 0; i < size; i += 1) {
+
+        float x = source[i];
+
+        float y = b0 * x + z1;
+
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+
+        dest[i] = y;
+
+    }
+
+    state[0] = z1;
+    state[1] = z2;
+
+}
+
+void Biquad_applyCascadeToSamples(BQ_cascade_t *cascade, const int16_t *source, float *dest, uint32_t size) {
+
+    /* The samples are converted once for the block and every section then works in place on the output */
+
+    for (uint32_t i = 0; i < size; i += 1) dest[i] = source[i];
+
+    for (uint32_t i = 0; i < cascade->numberOfSections; i += 1) {
+
+        applySection(cascade->state[i], cascade->coefficients + i, dest, dest, size);
+
+    }
+
+}
+
+void Biquad_applyCascade(BQ_cascade_t *cascade, const float *source, float *dest, uint32_t size) {
+
+    if (cascade->numberOfSections == 0) {
+
+        for (uint32_t i = 0; i < size; i += 1) dest[i] = source[i];
+
+        return;
+
+    }
+
+    applySection(cascade->state[0], cascade->coefficients, source, dest, size);
+
+    for (uint32_t i = 1; i < cascade->numberOfSections; i += 1) {
+
+        applySection(cascade->state[i], cascade->coefficients + i, dest, dest, size);
+
+    }
+
+}
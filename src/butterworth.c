@@ -238,6 +238,50 @@ void Butterworth_designHighPassFilter(BW_filterCoefficients_t *filterCoefficient
 
 }
 
+/* Filter design functions returning a second order section for Biquad_applyCascade() */
+
+void Butterworth_designLowPassBiquad(BQ_filterCoefficients_t *coefficients, uint32_t sampleRate, uint32_t freq) {
+
+    BW_filterCoefficients_t filterCoefficients;
+
+    designFilter(BW_LOW_PASS_FILTER, &filterCoefficients, sampleRate, freq, 0);
+
+    coefficients->B0_A0 = filterCoefficients.gain;
+    coefficients->B1_A0 = filterCoefficients.gain;
+    coefficients->B2_A0 = 0.0f;
+    coefficients->A1_A0 = -filterCoefficients.yc[0];
+    coefficients->A2_A0 = 0.0f;
+
+}
+
+void Butterworth_designHighPassBiquad(BQ_filterCoefficients_t *coefficients, uint32_t sampleRate, uint32_t freq) {
+
+    BW_filterCoefficients_t filterCoefficients;
+
+    designFilter(BW_HIGH_PASS_FILTER, &filterCoefficients, sampleRate, freq, 0);
+
+    coefficients->B0_A0 = filterCoefficients.gain;
+    coefficients->B1_A0 = -filterCoefficients.gain;
+    coefficients->B2_A0 = 0.0f;
+    coefficients->A1_A0 = -filterCoefficients.yc[0];
+    coefficients->A2_A0 = 0.0f;
+
+}
+
+void Butterworth_designBandPassBiquad(BQ_filterCoefficients_t *coefficients, uint32_t sampleRate, uint32_t freq1, uint32_t freq2) {
+
+    BW_filterCoefficients_t filterCoefficients;
+
+    designFilter(BW_BAND_PASS_FILTER, &filterCoefficients, sampleRate, freq1, freq2);
+
+    coefficients->B0_A0 = filterCoefficients.gain;
+    coefficients->B1_A0 = 0.0f;
+    coefficients->B2_A0 = -filterCoefficients.gain;
+    coefficients->A1_A0 = -filterCoefficients.yc[1];
+    coefficients->A2_A0 = -filterCoefficients.yc[0];
+
+}
+
 /* Initialise filter */
 
 void Butterworth_initialise(BW_filter_t *filter) {
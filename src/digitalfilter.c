@@ -6,6 +6,7 @@
 
 #include <math.h>
 #include <float.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <complex.h>
@@ -30,11 +31,36 @@
 
 #define MINIMUM_NUMBER_OF_ITERATIONS            16
 
+/* Extended output constants */
+
+#define EXTENDED_SAMPLE_FRACTIONAL_BITS         8
+#define MAXIMUM_EXTENDED_SAMPLE                 ((1 << 23) - 1)
+
+/* Decimation filter constants */
+
+#define CIC_ORDER                               3
+#define MINIMUM_CIC_DECIMATION                  2
+#define MAXIMUM_CIC_DECIMATION                  40
+
+#define HALF_BAND_DECIMATION                    2
+
+#define HALF_BAND_FILTER_LENGTH                 31
+#define HALF_BAND_FILTER_CENTRE                 (HALF_BAND_FILTER_LENGTH / 2)
+#define NUMBER_OF_HALF_BAND_COEFFICIENTS        ((HALF_BAND_FILTER_CENTRE + 1) / 2)
+
+#define COMPENSATION_PASS_BAND_EDGE             0.4f
+
+/* Filter kernel constants */
+
+#define MAXIMUM_SPECIALISED_DIVIDER             48
+
 /* Useful macros */
 
 #define MIN(a, b)                               ((a) < (b) ? (a) : (b))
 #define MAX(a, b)                               ((a) > (b) ? (a) : (b))
 
+#define ABS(a)                                  ((a) < 0 ? -(a) : (a))
+
 /* Filter global variables */
 
 static float gain;
@@ -71,6 +97,33 @@ static float goertzelFilterThreshold;
 
 static float goertzelFilterConstant;
 
+/* Dual gain variable */
+
+static float secondaryGain = 1.0f;
+
+/* Decimation filter variables */
+
+static DF_decimationType_t decimationType;
+
+static uint32_t decimationSampleRateDivider;
+
+static uint32_t cicDecimation;
+
+static float decimationScale;
+
+static float halfBandCoefficients[NUMBER_OF_HALF_BAND_COEFFICIENTS];
+
+static float compensationCoefficient;
+
+static uint32_t cicIntegrators[CIC_ORDER];
+static uint32_t cicCombs[CIC_ORDER];
+
+static float halfBandHistory[2 * HALF_BAND_FILTER_LENGTH];
+
+static uint32_t halfBandIndex;
+
+static float cv0, cv1;
+
 /* Static filter design functions */
 
 static complex float blt(complex float pz) {
@@ -153,66 +206,388 @@ static inline float applyBandPassFilter(float sample) {
 
 }
 
-/* General filter routine */
+/* Static decimation filter functions */
 
-static bool filter(int16_t *source, int16_t *dest, uint32_t sampleRateDivider, uint32_t size) {
+static inline float applyCICFilter(int16_t *source) {
 
-    uint32_t index = 0;
+    /* Integrators run at the input rate and wrap modulo 2^32, which the combs cancel exactly */
 
-    bool exceededThreshold = false;
+    for (uint32_t i = 0; i < cicDecimation; i += 1) {
 
-    for (uint32_t i = 0; i < size; i += sampleRateDivider) {
+        uint32_t value = (uint32_t)(int32_t)source[i];
 
-        float sample = 0.0f;
+        for (uint32_t j = 0; j < CIC_ORDER; j += 1) {
 
-        for (uint32_t j = 0; j < sampleRateDivider; j += 1) {
+            cicIntegrators[j] += value;
 
-            sample += source[i + j];
+            value = cicIntegrators[j];
 
         }
 
-        float filterOutput;
+    }
 
-        if (filterType == DF_HIGH_PASS_FILTER) {
+    /* Combs run at the decimated rate */
 
-            filterOutput = applyHighPassFilter(sample);
+    uint32_t value = cicIntegrators[CIC_ORDER - 1];
 
-        } else {
+    for (uint32_t j = 0; j < CIC_ORDER; j += 1) {
 
-            filterOutput = applyBandPassFilter(sample);
+        uint32_t previous = cicCombs[j];
 
-        }
+        cicCombs[j] = value;
+
+        value -= previous;
 
-        /* Apply output range limits */
+    }
 
-        if (filterOutput > INT16_MAX) {
+    return (float)(int32_t)value * decimationScale;
 
-            filterOutput = INT16_MAX;
+}
 
-        } else if (filterOutput < -INT16_MAX) {
+static inline float applyHalfBandFilter() {
 
-            filterOutput = -INT16_MAX;
+    /* Only the output phase that is kept is calculated, and only the non-zero odd taps of the symmetric half-band filter are used */
 
-        }
+    float *window = halfBandHistory + halfBandIndex;
 
-        /* Check if amplitude threshold is exceeded */
+    float output = 0.5f * window[HALF_BAND_FILTER_CENTRE];
 
-        if (fabsf(filterOutput) >= amplitudeThreshold) {
+    for (uint32_t k = 0; k < NUMBER_OF_HALF_BAND_COEFFICIENTS; k += 1) {
 
-            exceededThreshold = true;
+        uint32_t offset = 2 * k + 1;
 
-        }
+        output += halfBandCoefficients[k] * (window[HALF_BAND_FILTER_CENTRE - offset] + window[HALF_BAND_FILTER_CENTRE + offset]);
+
+    }
+
+    return output;
+
+}
+
+static inline float decimateSample(int16_t *source) {
+
+    for (uint32_t i = 0; i < HALF_BAND_DECIMATION; i += 1) {
+
+        float sample = applyCICFilter(source + i * cicDecimation);
+
+        /* Write each sample twice so the last HALF_BAND_FILTER_LENGTH samples are always contiguous */
+
+        halfBandHistory[halfBandIndex] = sample;
+        halfBandHistory[halfBandIndex + HALF_BAND_FILTER_LENGTH] = sample;
 
-        /* Write the output value */
+        halfBandIndex += 1;
 
-        dest[index++] = (int16_t)filterOutput;
+        if (halfBandIndex == HALF_BAND_FILTER_LENGTH) halfBandIndex = 0;
 
     }
 
-    return exceededThreshold;
+    float sample = applyHalfBandFilter();
+
+    /* Three tap filter to compensate for the CIC pass band droop */
+
+    float output = (1.0f + 2.0f * compensationCoefficient) * cv1 - compensationCoefficient * (cv0 + sample);
+
+    cv0 = cv1;
+    cv1 = sample;
+
+    return output;
+
+}
+
+static inline int32_t roundSample(float sample) {
+
+    return (int32_t)(sample + copysignf(0.5f, sample));
+
+}
+
+/* Functions to filter a single decimated sample and apply output range limits */
+
+static inline int32_t limitSample(float filterOutput) {
+
+    if (filterOutput > INT16_MAX) {
+
+        filterOutput = INT16_MAX;
+
+    } else if (filterOutput < -INT16_MAX) {
+
+        filterOutput = -INT16_MAX;
+
+    }
+
+    return (int32_t)filterOutput;
+
+}
+
+static inline int32_t filterHighPassSample(int32_t sample) {
+
+    return limitSample(applyHighPassFilter((float)sample));
+
+}
+
+static inline int32_t filterBandPassSample(int32_t sample) {
+
+    return limitSample(applyBandPassFilter((float)sample));
+
+}
+
+/* Functions to filter a single decimated sample and produce a unity gain and a secondary gain output */
+
+static inline void filterHighPassDualGainSample(int32_t sample, int32_t *primary, int32_t *secondary) {
+
+    float filterOutput = applyHighPassFilter((float)sample);
+
+    *primary = limitSample(filterOutput);
+
+    *secondary = limitSample(filterOutput * secondaryGain);
+
+}
+
+static inline void filterBandPassDualGainSample(int32_t sample, int32_t *primary, int32_t *secondary) {
+
+    float filterOutput = applyBandPassFilter((float)sample);
+
+    *primary = limitSample(filterOutput);
+
+    *secondary = limitSample(filterOutput * secondaryGain);
+
+}
+
+/* Functions to filter a single decimated sample and produce an extended resolution output */
+
+static inline int32_t limitExtendedSample(float filterOutput) {
+
+    filterOutput *= (float)(1 << EXTENDED_SAMPLE_FRACTIONAL_BITS);
+
+    if (filterOutput > MAXIMUM_EXTENDED_SAMPLE) {
+
+        filterOutput = MAXIMUM_EXTENDED_SAMPLE;
+
+    } else if (filterOutput < -MAXIMUM_EXTENDED_SAMPLE) {
+
+        filterOutput = -MAXIMUM_EXTENDED_SAMPLE;
+
+    }
+
+    return (int32_t)filterOutput;
+
+}
+
+static inline int32_t filterHighPassExtendedSample(int32_t sample) {
+
+    return limitExtendedSample(applyHighPassFilter((float)sample));
+
+}
+
+static inline int32_t filterBandPassExtendedSample(int32_t sample) {
+
+    return limitExtendedSample(applyBandPassFilter((float)sample));
+
+}
+
+/* Decimate and filter kernels. Each filter type has a generic kernel and one kernel per common sample rate divider with the summation loop unrolled at compile time */
+
+typedef bool (*filterKernel_t)(int16_t *source, int16_t *dest, uint32_t sampleRateDivider, uint32_t size);
+
+#define DEFINE_FILTER_KERNEL(name, filterSample, divider) \
+static bool name(int16_t *source, int16_t *dest, uint32_t sampleRateDivider, uint32_t size) { \
+    uint32_t index = 0; \
+    bool exceededThreshold = false; \
+    for (uint32_t i = 0; i < size; i += (divider)) { \
+        int32_t sample = 0; \
+        for (uint32_t j = 0; j < (divider); j += 1) { \
+            sample += source[i + j]; \
+        } \
+        int32_t filterOutput = filterSample(sample); \
+        if (ABS(filterOutput) >= amplitudeThreshold) exceededThreshold = true; \
+        dest[index++] = (int16_t)filterOutput; \
+    } \
+    return exceededThreshold; \
+}
+
+#define DEFINE_FILTER_KERNELS(type, filterSample) \
+    DEFINE_FILTER_KERNEL(type ## FilterGeneric, filterSample, sampleRateDivider) \
+    DEFINE_FILTER_KERNEL(type ## Filter1, filterSample, 1) \
+    DEFINE_FILTER_KERNEL(type ## Filter2, filterSample, 2) \
+    DEFINE_FILTER_KERNEL(type ## Filter3, filterSample, 3) \
+    DEFINE_FILTER_KERNEL(type ## Filter4, filterSample, 4) \
+    DEFINE_FILTER_KERNEL(type ## Filter6, filterSample, 6) \
+    DEFINE_FILTER_KERNEL(type ## Filter8, filterSample, 8) \
+    DEFINE_FILTER_KERNEL(type ## Filter12, filterSample, 12) \
+    DEFINE_FILTER_KERNEL(type ## Filter16, filterSample, 16) \
+    DEFINE_FILTER_KERNEL(type ## Filter24, filterSample, 24) \
+    DEFINE_FILTER_KERNEL(type ## Filter48, filterSample, 48) \
+    static const filterKernel_t type ## FilterKernels[MAXIMUM_SPECIALISED_DIVIDER + 1] = { \
+        [1] = type ## Filter1, [2] = type ## Filter2, [3] = type ## Filter3, [4] = type ## Filter4, \
+        [6] = type ## Filter6, [8] = type ## Filter8, [12] = type ## Filter12, [16] = type ## Filter16, \
+        [24] = type ## Filter24, [48] = type ## Filter48 \
+    };
+
+DEFINE_FILTER_KERNELS(highPass, filterHighPassSample)
+
+DEFINE_FILTER_KERNELS(bandPass, filterBandPassSample)
+
+/* Decimation filter kernels. These replace the sum over sampleRateDivider samples with the CIC and half-band decimator */
+
+#define DEFINE_DECIMATION_KERNEL(name, filterSample) \
+static bool name(int16_t *source, int16_t *dest, uint32_t sampleRateDivider, uint32_t size) { \
+    uint32_t index = 0; \
+    bool exceededThreshold = false; \
+    for (uint32_t i = 0; i < size; i += sampleRateDivider) { \
+        int32_t filterOutput = filterSample(roundSample(decimateSample(source + i))); \
+        if (ABS(filterOutput) >= amplitudeThreshold) exceededThreshold = true; \
+        dest[index++] = (int16_t)filterOutput; \
+    } \
+    return exceededThreshold; \
+}
+
+DEFINE_DECIMATION_KERNEL(highPassDecimationFilter, filterHighPassSample)
+
+DEFINE_DECIMATION_KERNEL(bandPassDecimationFilter, filterBandPassSample)
+
+/* Dual gain kernels. These write both outputs from each filtered sample and, like the filter kernels, have a generic kernel and one kernel per common sample rate divider */
+
+typedef bool (*dualGainKernel_t)(int16_t *source, int16_t *dest, int16_t *secondaryDest, uint32_t sampleRateDivider, uint32_t size);
+
+#define DEFINE_DUAL_GAIN_KERNEL(name, filterDualGainSample, divider) \
+static bool name(int16_t *source, int16_t *dest, int16_t *secondaryDest, uint32_t sampleRateDivider, uint32_t size) { \
+    uint32_t index = 0; \
+    bool exceededThreshold = false; \
+    for (uint32_t i = 0; i < size; i += (divider)) { \
+        int32_t sample = 0; \
+        for (uint32_t j = 0; j < (divider); j += 1) { \
+            sample += source[i + j]; \
+        } \
+        int32_t primary, secondary; \
+        filterDualGainSample(sample, &primary, &secondary); \
+        if (ABS(primary) >= amplitudeThreshold) exceededThreshold = true; \
+        dest[index] = (int16_t)primary; \
+        secondaryDest[index++] = (int16_t)secondary; \
+    } \
+    return exceededThreshold; \
+}
 
+#define DEFINE_DUAL_GAIN_KERNELS(type, filterDualGainSample) \
+    DEFINE_DUAL_GAIN_KERNEL(type ## DualGainFilterGeneric, filterDualGainSample, sampleRateDivider) \
+    DEFINE_DUAL_GAIN_KERNEL(type ## DualGainFilter1, filterDualGainSample, 1) \
+    DEFINE_DUAL_GAIN_KERNEL(type ## DualGainFilter2, filterDualGainSample, 2) \
+    DEFINE_DUAL_GAIN_KERNEL(type ## DualGainFilter3, filterDualGainSample, 3) \
+    DEFINE_DUAL_GAIN_KERNEL(type ## DualGainFilter4, filterDualGainSample, 4) \
+    DEFINE_DUAL_GAIN_KERNEL(type ## DualGainFilter6, filterDualGainSample, 6) \
+    DEFINE_DUAL_GAIN_KERNEL(type ## DualGainFilter8, filterDualGainSample, 8) \
+    DEFINE_DUAL_GAIN_KERNEL(type ## DualGainFilter12, filterDualGainSample, 12) \
+    DEFINE_DUAL_GAIN_KERNEL(type ## DualGainFilter16, filterDualGainSample, 16) \
+    DEFINE_DUAL_GAIN_KERNEL(type ## DualGainFilter24, filterDualGainSample, 24) \
+    DEFINE_DUAL_GAIN_KERNEL(type ## DualGainFilter48, filterDualGainSample, 48) \
+    static const dualGainKernel_t type ## DualGainFilterKernels[MAXIMUM_SPECIALISED_DIVIDER + 1] = { \
+        [1] = type ## DualGainFilter1, [2] = type ## DualGainFilter2, [3] = type ## DualGainFilter3, [4] = type ## DualGainFilter4, \
+        [6] = type ## DualGainFilter6, [8] = type ## DualGainFilter8, [12] = type ## DualGainFilter12, [16] = type ## DualGainFilter16, \
+        [24] = type ## DualGainFilter24, [48] = type ## DualGainFilter48 \
+    };
+
+DEFINE_DUAL_GAIN_KERNELS(highPass, filterHighPassDualGainSample)
+
+DEFINE_DUAL_GAIN_KERNELS(bandPass, filterBandPassDualGainSample)
+
+#define DEFINE_DUAL_GAIN_DECIMATION_KERNEL(name, filterDualGainSample) \
+static bool name(int16_t *source, int16_t *dest, int16_t *secondaryDest, uint32_t sampleRateDivider, uint32_t size) { \
+    uint32_t index = 0; \
+    bool exceededThreshold = false; \
+    for (uint32_t i = 0; i < size; i += sampleRateDivider) { \
+        int32_t primary, secondary; \
+        filterDualGainSample(roundSample(decimateSample(source + i)), &primary, &secondary); \
+        if (ABS(primary) >= amplitudeThreshold) exceededThreshold = true; \
+        dest[index] = (int16_t)primary; \
+        secondaryDest[index++] = (int16_t)secondary; \
+    } \
+    return exceededThreshold; \
 }
 
+DEFINE_DUAL_GAIN_DECIMATION_KERNEL(highPassDualGainDecimationFilter, filterHighPassDualGainSample)
+
+DEFINE_DUAL_GAIN_DECIMATION_KERNEL(bandPassDualGainDecimationFilter, filterBandPassDualGainSample)
+
+/* Extended kernels. These keep the fractional bits of the filter output, write packed little-endian 24-bit samples and, like the filter kernels, have a generic kernel and one kernel per common sample rate divider */
+
+typedef bool (*extendedKernel_t)(int16_t *source, uint8_t *dest, uint32_t sampleRateDivider, uint32_t size);
+
+#define DEFINE_EXTENDED_KERNEL(name, filterExtendedSample, divider) \
+static bool name(int16_t *source, uint8_t *dest, uint32_t sampleRateDivider, uint32_t size) { \
+    bool exceededThreshold = false; \
+    int32_t extendedAmplitudeThreshold = (int32_t)amplitudeThreshold << EXTENDED_SAMPLE_FRACTIONAL_BITS; \
+    for (uint32_t i = 0; i < size; i += (divider)) { \
+        int32_t sample = 0; \
+        for (uint32_t j = 0; j < (divider); j += 1) { \
+            sample += source[i + j]; \
+        } \
+        int32_t filterOutput = filterExtendedSample(sample); \
+        if (ABS(filterOutput) >= extendedAmplitudeThreshold) exceededThreshold = true; \
+        *dest++ = (uint8_t)filterOutput; \
+        *dest++ = (uint8_t)(filterOutput >> 8); \
+        *dest++ = (uint8_t)(filterOutput >> 16); \
+    } \
+    return exceededThreshold; \
+}
+
+#define DEFINE_EXTENDED_KERNELS(type, filterExtendedSample) \
+    DEFINE_EXTENDED_KERNEL(type ## ExtendedFilterGeneric, filterExtendedSample, sampleRateDivider) \
+    DEFINE_EXTENDED_KERNEL(type ## ExtendedFilter1, filterExtendedSample, 1) \
+    DEFINE_EXTENDED_KERNEL(type ## ExtendedFilter2, filterExtendedSample, 2) \
+    DEFINE_EXTENDED_KERNEL(type ## ExtendedFilter3, filterExtendedSample, 3) \
+    DEFINE_EXTENDED_KERNEL(type ## ExtendedFilter4, filterExtendedSample, 4) \
+    DEFINE_EXTENDED_KERNEL(type ## ExtendedFilter6, filterExtendedSample, 6) \
+    DEFINE_EXTENDED_KERNEL(type ## ExtendedFilter8, filterExtendedSample, 8) \
+    DEFINE_EXTENDED_KERNEL(type ## ExtendedFilter12, filterExtendedSample, 12) \
+    DEFINE_EXTENDED_KERNEL(type ## ExtendedFilter16, filterExtendedSample, 16) \
+    DEFINE_EXTENDED_KERNEL(type ## ExtendedFilter24, filterExtendedSample, 24) \
+    DEFINE_EXTENDED_KERNEL(type ## ExtendedFilter48, filterExtendedSample, 48) \
+    static const extendedKernel_t type ## ExtendedFilterKernels[MAXIMUM_SPECIALISED_DIVIDER + 1] = { \
+        [1] = type ## ExtendedFilter1, [2] = type ## ExtendedFilter2, [3] = type ## ExtendedFilter3, [4] = type ## ExtendedFilter4, \
+        [6] = type ## ExtendedFilter6, [8] = type ## ExtendedFilter8, [12] = type ## ExtendedFilter12, [16] = type ## ExtendedFilter16, \
+        [24] = type ## ExtendedFilter24, [48] = type ## ExtendedFilter48 \
+    };
+
+DEFINE_EXTENDED_KERNELS(highPass, filterHighPassExtendedSample)
+
+DEFINE_EXTENDED_KERNELS(bandPass, filterBandPassExtendedSample)
+
+#define DEFINE_EXTENDED_DECIMATION_KERNEL(name, filterExtendedSample) \
+static bool name(int16_t *source, uint8_t *dest, uint32_t sampleRateDivider, uint32_t size) { \
+    bool exceededThreshold = false; \
+    int32_t extendedAmplitudeThreshold = (int32_t)amplitudeThreshold << EXTENDED_SAMPLE_FRACTIONAL_BITS; \
+    for (uint32_t i = 0; i < size; i += sampleRateDivider) { \
+        int32_t filterOutput = filterExtendedSample(roundSample(decimateSample(source + i))); \
+        if (ABS(filterOutput) >= extendedAmplitudeThreshold) exceededThreshold = true; \
+        *dest++ = (uint8_t)filterOutput; \
+        *dest++ = (uint8_t)(filterOutput >> 8); \
+        *dest++ = (uint8_t)(filterOutput >> 16); \
+    } \
+    return exceededThreshold; \
+}
+
+DEFINE_EXTENDED_DECIMATION_KERNEL(highPassExtendedDecimationFilter, filterHighPassExtendedSample)
+
+DEFINE_EXTENDED_DECIMATION_KERNEL(bandPassExtendedDecimationFilter, filterBandPassExtendedSample)
+
+/* Selected kernels */
+
+static const filterKernel_t *selectedFilterKernels = highPassFilterKernels;
+
+static filterKernel_t selectedGenericFilterKernel = highPassFilterGeneric;
+
+static filterKernel_t selectedDecimationFilterKernel = highPassDecimationFilter;
+
+static const dualGainKernel_t *selectedDualGainFilterKernels = highPassDualGainFilterKernels;
+
+static dualGainKernel_t selectedGenericDualGainFilterKernel = highPassDualGainFilterGeneric;
+
+static dualGainKernel_t selectedDualGainDecimationFilterKernel = highPassDualGainDecimationFilter;
+
+static const extendedKernel_t *selectedExtendedFilterKernels = highPassExtendedFilterKernels;
+
+static extendedKernel_t selectedGenericExtendedFilterKernel = highPassExtendedFilterGeneric;
+
+static extendedKernel_t selectedExtendedDecimationFilterKernel = highPassExtendedDecimationFilter;
+
 /* Fast filter routine for when 250kHz and 384kHz and sampleRateDivider is not needed */
 
 static bool fastFilterWithGoertzelFilterThreshold(int16_t *source, int16_t *dest, uint32_t size) {
@@ -331,142 +706,157 @@ static bool fastFilterWithGoertzelFilterThreshold(int16_t *source, int16_t *dest
 
 }
 
-static bool fastFilterWithAmplitudeThreshold(int16_t *source, int16_t *dest, uint32_t size) {
+/* Select the filter kernels that match the current filter design */
 
-    uint32_t index = 0;
-
-    bool exceededThreshold = false;
+static void selectFilterKernels() {
 
     if (filterType == DF_HIGH_PASS_FILTER) {
 
-        for (uint32_t i = 0; i < size / MINIMUM_NUMBER_OF_ITERATIONS; i += 1) {
+        selectedFilterKernels = highPassFilterKernels;
 
-            for (uint32_t j = 0; j < MINIMUM_NUMBER_OF_ITERATIONS; j += 1) {
+        selectedGenericFilterKernel = highPassFilterGeneric;
 
-                float sample = source[index];
+        selectedDecimationFilterKernel = highPassDecimationFilter;
 
-                float filterOutput = applyHighPassFilter(sample);
+        selectedDualGainFilterKernels = highPassDualGainFilterKernels;
 
-                /* Apply output range limits */
+        selectedGenericDualGainFilterKernel = highPassDualGainFilterGeneric;
 
-                if (filterOutput > INT16_MAX) {
+        selectedDualGainDecimationFilterKernel = highPassDualGainDecimationFilter;
 
-                    filterOutput = INT16_MAX;
+        selectedExtendedFilterKernels = highPassExtendedFilterKernels;
 
-                } else if (filterOutput < -INT16_MAX) {
+        selectedGenericExtendedFilterKernel = highPassExtendedFilterGeneric;
 
-                    filterOutput = -INT16_MAX;
+        selectedExtendedDecimationFilterKernel = highPassExtendedDecimationFilter;
 
-                }
+    } else {
 
-                /* Check if amplitude threshold is exceeded */
+        selectedFilterKernels = bandPassFilterKernels;
 
-                if (fabsf(filterOutput) >= amplitudeThreshold) {
+        selectedGenericFilterKernel = bandPassFilterGeneric;
 
-                    exceededThreshold = true;
+        selectedDecimationFilterKernel = bandPassDecimationFilter;
 
-                }
+        selectedDualGainFilterKernels = bandPassDualGainFilterKernels;
 
-                /* Write the output value */
+        selectedGenericDualGainFilterKernel = bandPassDualGainFilterGeneric;
 
-                dest[index++] = (int16_t)filterOutput;
+        selectedDualGainDecimationFilterKernel = bandPassDualGainDecimationFilter;
 
-            }
+        selectedExtendedFilterKernels = bandPassExtendedFilterKernels;
 
-        }
+        selectedGenericExtendedFilterKernel = bandPassExtendedFilterGeneric;
 
-    } else {
+        selectedExtendedDecimationFilterKernel = bandPassExtendedDecimationFilter;
 
-        for (uint32_t i = 0; i < size / MINIMUM_NUMBER_OF_ITERATIONS; i += 1) {
+    }
 
-            for (uint32_t j = 0; j < MINIMUM_NUMBER_OF_ITERATIONS; j += 1) {
+}
 
-                float sample = source[index];
+/* Reset the filter */
 
-                float filterOutput = applyBandPassFilter(sample);
+void DigitalFilter_reset() {
 
-                /* Apply output range limits */
+    xv0 = 0.0f;
+    xv1 = 0.0f;
+    xv2 = 0.0f;
 
-                if (filterOutput > INT16_MAX) {
+    yv0 = 0.0f;
+    yv1 = 0.0f;
+    yv2 = 0.0f;
 
-                    filterOutput = INT16_MAX;
+    for (uint32_t i = 0; i < CIC_ORDER; i += 1) {
 
-                } else if (filterOutput < -INT16_MAX) {
+        cicIntegrators[i] = 0;
 
-                    filterOutput = -INT16_MAX;
+        cicCombs[i] = 0;
 
-                }
+    }
 
-                /* Check if amplitude threshold is exceeded */
+    for (uint32_t i = 0; i < 2 * HALF_BAND_FILTER_LENGTH; i += 1) halfBandHistory[i] = 0.0f;
 
-                if (fabsf(filterOutput) >= amplitudeThreshold) {
+    halfBandIndex = 0;
 
-                    exceededThreshold = true;
+    cv0 = 0.0f;
+    cv1 = 0.0f;
 
-                }
+    amplitudeThreshold = 0;
 
-                /* Write the output value */
+    goertzelFilterThreshold = 0.0f;
 
-                dest[index++] = (int16_t)filterOutput;
+}
 
-            }
+/* Update filter gain */
 
-        }
+void DigitalFilter_setAdditionalGain(float g) {
 
-    }
+    gain *= g;
 
-    return exceededThreshold;
+}
+
+/* Set the digital gain of the secondary output of the dual gain filter */
+
+void DigitalFilter_setSecondaryGain(float g) {
+
+    secondaryGain = g;
 
 }
 
-/* Reset the filter */
+/* Apply digital filter */
 
-void DigitalFilter_reset() {
+bool DigitalFilter_applyFilter(int16_t *source, int16_t *dest, uint32_t sampleRateDivider, uint32_t size) {
 
-    xv0 = 0.0f;
-    xv1 = 0.0f;
-    xv2 = 0.0f;
+    if (sampleRateDivider == 1 && goertzelFilterThreshold > 0.0f) {
 
-    yv0 = 0.0f;
-    yv1 = 0.0f;
-    yv2 = 0.0f;
+        return fastFilterWithGoertzelFilterThreshold(source, dest, size);
 
-    amplitudeThreshold = 0;
+    }
 
-    goertzelFilterThreshold = 0.0f;
+    if (decimationType == DF_CIC_FIR_DECIMATION && sampleRateDivider == decimationSampleRateDivider) {
 
-}
+        return selectedDecimationFilterKernel(source, dest, sampleRateDivider, size);
 
-/* Update filter gain */
+    }
 
-void DigitalFilter_setAdditionalGain(float g) {
+    filterKernel_t kernel = sampleRateDivider <= MAXIMUM_SPECIALISED_DIVIDER ? selectedFilterKernels[sampleRateDivider] : NULL;
 
-    gain *= g;
+    if (kernel == NULL) kernel = selectedGenericFilterKernel;
+
+    return kernel(source, dest, sampleRateDivider, size);
 
 }
 
-/* Apply digital filter */
+bool DigitalFilter_applyDualGainFilter(int16_t *source, int16_t *dest, int16_t *secondaryDest, uint32_t sampleRateDivider, uint32_t size) {
 
-bool DigitalFilter_applyFilter(int16_t *source, int16_t *dest, uint32_t sampleRateDivider, uint32_t size) {
+    if (decimationType == DF_CIC_FIR_DECIMATION && sampleRateDivider == decimationSampleRateDivider) {
 
-    if (sampleRateDivider == 1) {
+        return selectedDualGainDecimationFilterKernel(source, dest, secondaryDest, sampleRateDivider, size);
 
-        if (goertzelFilterThreshold > 0.0f) {
+    }
 
-            return fastFilterWithGoertzelFilterThreshold(source, dest, size);
+    dualGainKernel_t kernel = sampleRateDivider <= MAXIMUM_SPECIALISED_DIVIDER ? selectedDualGainFilterKernels[sampleRateDivider] : NULL;
 
-        } else {
+    if (kernel == NULL) kernel = selectedGenericDualGainFilterKernel;
 
-            return fastFilterWithAmplitudeThreshold(source, dest, size);
+    return kernel(source, dest, secondaryDest, sampleRateDivider, size);
 
-        }
+}
 
-    } else {
+bool DigitalFilter_applyExtendedFilter(int16_t *source, uint8_t *dest, uint32_t sampleRateDivider, uint32_t size) {
+
+    if (decimationType == DF_CIC_FIR_DECIMATION && sampleRateDivider == decimationSampleRateDivider) {
 
-        return filter(source, dest, sampleRateDivider, size);
+        return selectedExtendedDecimationFilterKernel(source, dest, sampleRateDivider, size);
 
     }
 
+    extendedKernel_t kernel = sampleRateDivider <= MAXIMUM_SPECIALISED_DIVIDER ? selectedExtendedFilterKernels[sampleRateDivider] : NULL;
+
+    if (kernel == NULL) kernel = selectedGenericExtendedFilterKernel;
+
+    return kernel(source, dest, sampleRateDivider, size);
+
 }
 
 bool DigitalFilter_applyFrequencyTrigger(int16_t *source, uint32_t size) {
@@ -606,6 +996,8 @@ static void designFilter(uint32_t sampleRate, DF_filterType_t type, uint32_t fre
 
     }
 
+    selectFilterKernels();
+
 }
 
 /* Design filters */
@@ -631,6 +1023,8 @@ void DigitalFilter_designBandPassFilter(uint32_t sampleRate, uint32_t freq1, uin
 
         filterType = DF_HIGH_PASS_FILTER;
 
+            selectFilterKernels();
+
     } else if (freq2 == sampleRate / 2) {
 
         designFilter(sampleRate, DF_HIGH_PASS_FILTER, freq1, 0);
@@ -643,6 +1037,56 @@ void DigitalFilter_designBandPassFilter(uint32_t sampleRate, uint32_t freq1, uin
 
 }
 
+void DigitalFilter_designDecimationFilter(DF_decimationType_t type, uint32_t sampleRateDivider) {
+
+    /* Decimate by two in the half-band filter and by the remainder in the CIC filter */
+
+    cicDecimation = sampleRateDivider / HALF_BAND_DECIMATION;
+
+    /* Odd dividers, CIC outputs that do not fit in 32 bits, and divider 2, where the half-band filter runs at 192 kHz and overruns the DMA interrupt budget, fall back to the boxcar sum */
+
+    bool available = sampleRateDivider % HALF_BAND_DECIMATION == 0 && cicDecimation >= MINIMUM_CIC_DECIMATION && cicDecimation <= MAXIMUM_CIC_DECIMATION;
+
+    decimationType = type == DF_CIC_FIR_DECIMATION && available ? DF_CIC_FIR_DECIMATION : DF_BOXCAR_DECIMATION;
+
+    decimationSampleRateDivider = sampleRateDivider;
+
+    if (decimationType == DF_BOXCAR_DECIMATION) return;
+
+    /* Scale the CIC gain so the output matches the boxcar sum of sampleRateDivider samples */
+
+    float cicGain = powf((float)cicDecimation, CIC_ORDER);
+
+    decimationScale = (float)sampleRateDivider / cicGain;
+
+    /* Hamming windowed half-band filter with cut-off at the output Nyquist frequency */
+
+    float sum = 0.0f;
+
+    for (uint32_t k = 0; k < NUMBER_OF_HALF_BAND_COEFFICIENTS; k += 1) {
+
+        float offset = (float)(2 * k + 1);
+
+        float window = 0.54f + 0.46f * cosf(M_PI * offset / (float)HALF_BAND_FILTER_CENTRE);
+
+        halfBandCoefficients[k] = window * sinf(M_PI * offset / 2.0f) / (M_PI * offset);
+
+        sum += halfBandCoefficients[k];
+
+    }
+
+    /* Normalise for unity gain at DC */
+
+    for (uint32_t k = 0; k < NUMBER_OF_HALF_BAND_COEFFICIENTS; k += 1) halfBandCoefficients[k] *= 0.25f / sum;
+
+    /* Set the compensation filter to cancel the CIC droop at the pass band edge */
+
+    float droop = powf(sinf(M_PI * COMPENSATION_PASS_BAND_EDGE / (float)HALF_BAND_DECIMATION) / ((float)cicDecimation * sinf(M_PI * COMPENSATION_PASS_BAND_EDGE / (float)sampleRateDivider)), CIC_ORDER);
+
+    compensationCoefficient = (1.0f / droop - 1.0f) / (2.0f * (1.0f - cosf(M_TWOPI * COMPENSATION_PASS_BAND_EDGE)));
+
+}
+
 /* Set threshold options */
 
 void DigitalFilter_setAmplitudeThreshold(uint16_t threshold) {
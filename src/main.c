@@ -14,6 +14,7 @@
 #include "audioconfig.h"
 #include "audiomoth.h"
 #include "digitalfilter.h"
+#include "schedule.h"
 
 /* Useful time constants */
 
@@ -27,8 +28,6 @@
 #define YEAR_OFFSET                             1900
 #define MONTH_OFFSET                            1
 
-#define START_OF_CENTURY                        946684800
-#define MIDPOINT_OF_CENTURY                     2524608000
 
 /* Useful type constants */
 
@@ -52,12 +51,23 @@
 #define SHORT_WAIT_INTERVAL                     100
 #define DEFAULT_WAIT_INTERVAL                   1000
 
-/* SRAM buffer constants */
+#define MAXIMUM_TICKLESS_WAIT_INTERVAL          30000
+
+/* Output sample constants */
+
+#define ENABLE_24_BIT_OUTPUT                    false
+
+/* SRAM buffer constants. Packed 24-bit samples still use a power of two samples in each buffer so it is filled after an integer number of DMA transfers */
 
 #define NUMBER_OF_BUFFERS                       8
 #define NUMBER_OF_BYTES_IN_SAMPLE               2
-#define EXTERNAL_SRAM_SIZE_IN_SAMPLES           (AM_EXTERNAL_SRAM_SIZE_IN_BYTES / NUMBER_OF_BYTES_IN_SAMPLE)
-#define NUMBER_OF_SAMPLES_IN_BUFFER             (EXTERNAL_SRAM_SIZE_IN_SAMPLES / NUMBER_OF_BUFFERS)
+#define NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE        (ENABLE_24_BIT_OUTPUT ? 3 : NUMBER_OF_BYTES_IN_SAMPLE)
+#define NUMBER_OF_BYTES_IN_BUFFER               (AM_EXTERNAL_SRAM_SIZE_IN_BYTES / NUMBER_OF_BUFFERS)
+#define NUMBER_OF_SAMPLES_IN_BUFFER             (NUMBER_OF_BYTES_IN_BUFFER / (ENABLE_24_BIT_OUTPUT ? 4 : NUMBER_OF_BYTES_IN_SAMPLE))
+
+/* SD card write constant. This limits how long written buffers are held before being released back to the ring */
+
+#define MAXIMUM_NUMBER_OF_BUFFERS_IN_WRITE      (NUMBER_OF_BUFFERS / 2)
 
 /* DMA transfer constant */
 
@@ -69,25 +79,48 @@
 
 /* File size constants */
 
-#define MAXIMUM_FILE_NAME_LENGTH                32
+#define MAXIMUM_FILE_NAME_LENGTH                64
+
+#define FILE_OPEN_ALLOWANCE                     250
+
+/* Microphone start constant */
+
+#define MICROPHONE_WARM_UP_PERIOD               100
 
 #define MAXIMUM_WAV_FILE_SIZE                   UINT32_MAX
 
+#define PREALLOCATE_RECORDING_FILES             true
+#define MAXIMUM_PREALLOCATION_DURATION          300
+
 /* Configuration file constants */
 
 #define CONFIG_BUFFER_LENGTH                    512
 #define CONFIG_TIMEZONE_LENGTH                  12
 
-/* WAV header constant */
+/* Recording statistics file constants. The file costs a directory search and FAT update after every recording so it is off by default */
+
+#define WRITE_RECORDING_STATISTICS              false
+
+#define STATISTICS_FILENAME                     "STATISTICS.CSV"
+#define STATISTICS_HEADER                       "File,Samples,Dropped buffers,Maximum buffers in use,SD busy <1ms,SD busy 1-2ms,SD busy 2-4ms,SD busy 4-8ms,SD busy 8-16ms,SD busy 16-32ms,SD busy 32-64ms,SD busy 64-128ms,SD busy 128-256ms,SD busy >256ms\r\n"
+
+#define MAXIMUM_STATISTICS_FIELD_LENGTH         11
+#define STATISTICS_BUFFER_LENGTH                (MAXIMUM_FILE_NAME_LENGTH + (3 + AM_SD_CARD_BUSY_HISTOGRAM_BINS) * MAXIMUM_STATISTICS_FIELD_LENGTH + 3)
+
+/* WAV header constants. The header is padded to a whole number of sectors, and for 24-bit samples to a whole number of samples */
 
 #define PCM_FORMAT                              1
 #define RIFF_ID_LENGTH                          4
 #define LENGTH_OF_ARTIST                        32
 #define LENGTH_OF_COMMENT                       384
+#define SECTOR_SIZE_IN_BYTES                    512
+#define WAV_HEADER_SIZE_IN_BYTES                (SECTOR_SIZE_IN_BYTES * (ENABLE_24_BIT_OUTPUT ? 3 : 1))
+
+#define NUMBER_OF_SAMPLES_IN_SECTOR_BLOCK       (WAV_HEADER_SIZE_IN_BYTES / NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE)
 
 /* USB configuration constant */
 
-#define MAX_RECORDING_PERIODS                   5
+#define MAX_RECORDING_PERIODS                   SC_MAX_RECORDING_PERIODS
 
 
 /* DC filter constants */
@@ -95,6 +128,36 @@
 #define LOW_DC_BLOCKING_FREQ                    8
 #define DEFAULT_DC_BLOCKING_FREQ                48
 
+/* Decimation filter constant */
+
+#define DECIMATION_FILTER                       DF_CIC_FIR_DECIMATION
+
+/* Single capture dual gain constant */
+
+#define SINGLE_CAPTURE_DUAL_GAIN                false
+
+/* Gapless dual gain handoff constant */
+
+#define GAPLESS_DUAL_GAIN_HANDOFF               true
+
+/* Additional gain steps constants */
+
+#define MAX_ADDITIONAL_GAIN_STEPS               2
+#define MAX_RECORDING_STEPS                     (2 + MAX_ADDITIONAL_GAIN_STEPS)
+
+/* Folder sharding constants */
+
+#define FOLDER_SHARDING                         NO_FOLDER_SHARDING
+#define FILES_PER_NUMBERED_FOLDER               1000
+#define NUMBERED_FOLDER_FORMAT                  "FOLDER%05lu"
+#define NO_CACHED_FOLDER                        UINT32_MAX
+
+/* Default mode file rollover constants, zero disables each limit */
+
+#define DEFAULT_MODE_ROLLOVER_DURATION          0
+#define DEFAULT_MODE_ROLLOVER_SIZE_IN_MB        0
+#define BYTES_IN_MB                             (1024 * 1024)
+
 /* Supply voltage constant */
 
 #define MINIMUM_SUPPLY_VOLTAGE                  2800
@@ -192,6 +255,14 @@
 
 typedef enum {RECORDING_OKAY, FILE_SIZE_LIMITED, SUPPLY_VOLTAGE_LOW, SWITCH_CHANGED, MICROPHONE_CHANGED, SDCARD_WRITE_ERROR} AM_recordingState_t;
 
+/* Folder sharding enumeration */
+
+typedef enum {NO_FOLDER_SHARDING, HOURLY_FOLDERS, NUMBERED_FOLDERS} AM_folderSharding_t;
+
+/* Capture mode enumeration */
+
+typedef enum {INDEPENDENT_CAPTURE, HAND_OFF_CAPTURE, CONTINUE_CAPTURE, CONTINUE_AND_HAND_OFF_CAPTURE} AM_captureMode_t;
+
 /* Filter type enumeration */
 
 typedef enum {NO_FILTER, LOW_PASS_FILTER, BAND_PASS_FILTER, HIGH_PASS_FILTER} AM_filterType_t;
@@ -228,6 +299,8 @@ typedef struct {
     uint16_t bitsPerSample;
 } wavFormat_t;
 
+#define LENGTH_OF_PADDING                       (WAV_HEADER_SIZE_IN_BYTES - 5 * sizeof(chunk_t) - 2 * RIFF_ID_LENGTH - sizeof(wavFormat_t) - sizeof(icmt_t) - sizeof(iart_t))
+
 typedef struct {
     chunk_t riff;
     char format[RIFF_ID_LENGTH];
@@ -237,6 +310,8 @@ typedef struct {
     char info[RIFF_ID_LENGTH];
     icmt_t icmt;
     iart_t iart;
+    chunk_t junk;
+    char padding[LENGTH_OF_PADDING];
     chunk_t data;
 } wavHeader_t;
 
@@ -246,11 +321,12 @@ static wavHeader_t wavHeader = {
     .riff = {.id = "RIFF", .size = 0},
     .format = "WAVE",
     .fmt = {.id = "fmt ", .size = sizeof(wavFormat_t)},
-    .wavFormat = {.format = PCM_FORMAT, .numberOfChannels = 1, .samplesPerSecond = 0, .bytesPerSecond = 0, .bytesPerCapture = 2, .bitsPerSample = 16},
+    .wavFormat = {.format = PCM_FORMAT, .numberOfChannels = 1, .samplesPerSecond = 0, .bytesPerSecond = 0, .bytesPerCapture = NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE, .bitsPerSample = BITS_PER_BYTE * NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE},
     .list = {.id = "LIST", .size = RIFF_ID_LENGTH + sizeof(icmt_t) + sizeof(iart_t)},
     .info = "INFO",
     .icmt = {.icmt.id = "ICMT", .icmt.size = LENGTH_OF_COMMENT, .comment = ""},
     .iart = {.iart.id = "IART", .iart.size = LENGTH_OF_ARTIST, .artist = ""},
+    .junk = {.id = "JUNK", .size = LENGTH_OF_PADDING},
     .data = {.id = "data", .size = 0}
 };
 
@@ -258,12 +334,6 @@ static wavHeader_t wavHeader = {
 
 #pragma pack(push, 1)
 
-typedef struct {
-    uint16_t startMinutes;
-    uint16_t endMinutes;
-} recordingPeriod_t;
-
-
 typedef struct {
     uint32_t time;
     AM_gainSetting_t gain1;
@@ -279,7 +349,7 @@ typedef struct {
     uint16_t recordDurationGain2;
     uint8_t enableLED;
     uint8_t activeRecordingPeriods;
-    recordingPeriod_t recordingPeriods[MAX_RECORDING_PERIODS];
+    SC_recordingPeriod_t recordingPeriods[MAX_RECORDING_PERIODS];
     int8_t timezoneHours;
     uint8_t enableLowVoltageCutoff;
     uint8_t disableBatteryLevelDisplay;
@@ -334,6 +404,13 @@ static const configSettings_t defaultConfigSettings = {
     .enableDailyFolders = 0
 };
 
+/* Additional gain steps recorded after gain2 in the same wake-up. They are taken from the sleep phase of the cycle and steps with zero duration are not recorded */
+
+static const SC_gainStep_t additionalGainSteps[MAX_ADDITIONAL_GAIN_STEPS] = {
+    {.gain = AM_GAIN_HIGH, .duration = 0, .sleepDurationBefore = 0},
+    {.gain = AM_GAIN_LOW_MEDIUM, .duration = 0, .sleepDurationBefore = 0}
+};
+
 /* Persistent configuration data structure */
 
 #pragma pack(push, 1)
@@ -351,13 +428,13 @@ typedef struct {
 static void setHeaderDetails(wavHeader_t *wavHeader, uint32_t sampleRate, uint32_t numberOfSamples) {
 
     wavHeader->wavFormat.samplesPerSecond = sampleRate;
-    wavHeader->wavFormat.bytesPerSecond = NUMBER_OF_BYTES_IN_SAMPLE * sampleRate;
-    wavHeader->data.size = NUMBER_OF_BYTES_IN_SAMPLE * numberOfSamples;
-    wavHeader->riff.size = NUMBER_OF_BYTES_IN_SAMPLE * numberOfSamples + sizeof(wavHeader_t) - sizeof(chunk_t);
+    wavHeader->wavFormat.bytesPerSecond = NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE * sampleRate;
+    wavHeader->data.size = NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE * numberOfSamples;
+    wavHeader->riff.size = NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE * numberOfSamples + sizeof(wavHeader_t) - sizeof(chunk_t);
 
 }
 
-static void setHeaderComment(wavHeader_t *wavHeader, configSettings_t *configSettings, uint32_t currentTime, uint8_t *serialNumber, uint8_t *deploymentID, uint8_t *defaultDeploymentID, AM_extendedBatteryState_t extendedBatteryState, int32_t temperature, AM_gainSetting_t gain, bool externalMicrophone, AM_recordingState_t recordingState) {
+static void setHeaderComment(wavHeader_t *wavHeader, configSettings_t *configSettings, uint32_t currentTime, uint8_t *serialNumber, uint8_t *deploymentID, uint8_t *defaultDeploymentID, AM_extendedBatteryState_t extendedBatteryState, int32_t temperature, AM_gainSetting_t gain, AM_gainSetting_t captureGain, bool externalMicrophone, uint32_t droppedBuffers, uint32_t maximumBuffersInUse, AM_recordingState_t recordingState) {
 
     struct tm time;
 
@@ -419,7 +496,15 @@ static void setHeaderComment(wavHeader_t *wavHeader, configSettings_t *configSet
 
     static char *gainSettings[5] = {"low", "low-medium", "medium", "medium-high", "high"};
 
-    comment += sprintf(comment, "at %s gain while battery was ", gainSettings[gain]);
+    if (gain == captureGain) {
+
+        comment += sprintf(comment, "at %s gain while battery was ", gainSettings[gain]);
+
+    } else {
+
+        comment += sprintf(comment, "at %s gain (derived digitally from %s gain) while battery was ", gainSettings[gain], gainSettings[captureGain]);
+
+    }
 
     if (extendedBatteryState == AM_EXT_BAT_LOW) {
 
@@ -443,6 +528,18 @@ static void setHeaderComment(wavHeader_t *wavHeader, configSettings_t *configSet
 
     comment += sprintf(comment, " and temperature was %s%lu.%luC.", sign, temperatureInDecidegrees / 10, temperatureInDecidegrees % 10);
 
+    comment += sprintf(comment, " At most %lu of %u buffers were in use", maximumBuffersInUse, NUMBER_OF_BUFFERS - 1);
+
+    if (droppedBuffers > 0) {
+
+        comment += sprintf(comment, " and %lu buffers were dropped.", droppedBuffers);
+
+    } else {
+
+        comment += sprintf(comment, " and no buffers were dropped.");
+
+    }
+
     if (recordingState != RECORDING_OKAY) {
 
         comment += sprintf(comment, " Recording stopped");
@@ -469,6 +566,38 @@ static void setHeaderComment(wavHeader_t *wavHeader, configSettings_t *configSet
 
 }
 
+/* Function to append the recording statistics to file */
+
+static bool writeStatisticsToFile(char *filename, uint32_t numberOfSamples, uint32_t droppedBuffers, uint32_t maximumBuffersInUse, uint32_t *busyHistogram) {
+
+    /* The buffer holds one line at its longest, with the file name and each field of up to ten digits and a comma, so the header is written separately */
+
+    static char statisticsBuffer[STATISTICS_BUFFER_LENGTH];
+
+    bool writeHeader = AudioMoth_doesFileExist(STATISTICS_FILENAME) == false;
+
+    uint32_t length = sprintf(statisticsBuffer, "%s,%lu,%lu,%lu", filename, numberOfSamples, droppedBuffers, maximumBuffersInUse);
+
+    for (uint32_t i = 0; i < AM_SD_CARD_BUSY_HISTOGRAM_BINS; i += 1) {
+
+        length += sprintf(statisticsBuffer + length, ",%lu", busyHistogram[i]);
+
+    }
+
+    length += sprintf(statisticsBuffer + length, "\r\n");
+
+    RETURN_BOOL_ON_ERROR(AudioMoth_appendFile(STATISTICS_FILENAME));
+
+    if (writeHeader) RETURN_BOOL_ON_ERROR(AudioMoth_writeToFile(STATISTICS_HEADER, sizeof(STATISTICS_HEADER) - 1));
+
+    RETURN_BOOL_ON_ERROR(AudioMoth_writeToFile(statisticsBuffer, length));
+
+    RETURN_BOOL_ON_ERROR(AudioMoth_closeFile());
+
+    return true;
+
+}
+
 /* Function to write configuration to file */
 
 static bool writeConfigurationToFile(configSettings_t *configSettings, uint8_t *firmwareDescription, uint8_t *firmwareVersion, uint8_t *serialNumber, uint8_t *deploymentID, uint8_t *defaultDeploymentID) {
@@ -576,6 +705,20 @@ static bool writeConfigurationToFile(configSettings_t *configSettings, uint8_t *
 
     RETURN_BOOL_ON_ERROR(AudioMoth_writeToFile(configBuffer, length));
 
+    /* The additional gain steps are listed so the schedule can be simulated from this file */
+
+    length = 0;
+
+    for (uint32_t i = 0; i < MAX_ADDITIONAL_GAIN_STEPS; i += 1) {
+
+        if (configSettings->disableSleepRecordCycle || additionalGainSteps[i].duration == 0) continue;
+
+        length += sprintf(configBuffer + length, "\r\nAdditional gain step %lu          : %s, %lu s after %lu s", i + 1, gainSettings[additionalGainSteps[i].gain], additionalGainSteps[i].duration, additionalGainSteps[i].sleepDurationBefore);
+
+    }
+
+    if (length > 0) RETURN_BOOL_ON_ERROR(AudioMoth_writeToFile(configBuffer, length));
+
     length = sprintf(configBuffer, "\r\n\r\nActive recording periods        : %u\r\n", configSettings->activeRecordingPeriods);
 
     /* Find the first recording period */
@@ -723,6 +866,22 @@ static uint32_t *poweredDownWithShortWaitInterval = (uint32_t*)(AM_BACKUP_DOMAIN
 
 static configSettings_t *configSettings = (configSettings_t*)(AM_BACKUP_DOMAIN_START_ADDRESS + 44);
 
+#define BACKUP_DOMAIN_FOLDER_CACHE_OFFSET       (44 + ROUND_UP_TO_MULTIPLE(sizeof(configSettings_t), UINT32_SIZE_IN_BYTES))
+
+static uint32_t *cachedFolderIdentity = (uint32_t*)(AM_BACKUP_DOMAIN_START_ADDRESS + BACKUP_DOMAIN_FOLDER_CACHE_OFFSET);
+
+static uint32_t *numberedFolderIndex = (uint32_t*)(AM_BACKUP_DOMAIN_START_ADDRESS + BACKUP_DOMAIN_FOLDER_CACHE_OFFSET + 4);
+
+static uint32_t *numberOfFilesInNumberedFolder = (uint32_t*)(AM_BACKUP_DOMAIN_START_ADDRESS + BACKUP_DOMAIN_FOLDER_CACHE_OFFSET + 8);
+
+_Static_assert(BACKUP_DOMAIN_FOLDER_CACHE_OFFSET + 12 <= AM_BACKUP_DOMAIN_SIZE_IN_BYTES, "Folder cache does not fit in the backup domain");
+
+#define BACKUP_DOMAIN_TIMELINE_OFFSET           (BACKUP_DOMAIN_FOLDER_CACHE_OFFSET + 12)
+
+static SC_timeline_t *timeline = (SC_timeline_t*)(AM_BACKUP_DOMAIN_START_ADDRESS + BACKUP_DOMAIN_TIMELINE_OFFSET);
+
+_Static_assert(BACKUP_DOMAIN_TIMELINE_OFFSET + sizeof(SC_timeline_t) <= AM_BACKUP_DOMAIN_SIZE_IN_BYTES, "Timeline does not fit in the backup domain");
+
 /* Filter variables */
 
 static AM_filterType_t requestedFilterType;
@@ -737,12 +896,63 @@ static volatile uint32_t writeBuffer;
 
 static volatile uint32_t writeBufferIndex;
 
+static volatile uint32_t readBuffer;
+
+static uint32_t readBufferIndex;
+
 static int16_t* buffers[NUMBER_OF_BUFFERS];
 
+static int16_t* secondaryBuffers[NUMBER_OF_BUFFERS];
+
+static uint32_t numberOfSamplesInBuffer;
+
+/* Single capture dual gain variables */
+
+static bool dualGainCapture;
+
+static const float analogGains[2][5] = {
+    {0.33f, 0.55f, 1.0f, 1.67f, 2.0f},
+    {4.33f, 7.0f, 15.0f, 25.0f, 30.0f}
+};
+
+/* Gapless dual gain handoff variables */
+
+static volatile uint32_t numberOfDMATransfersBeforeGainChange;
+
+static uint32_t numberOfDMATransfersAtHandoff;
+
+static AM_gainRange_t gainRangeOfCapture;
+
+static AM_gainSetting_t gainBeforeGainChange;
+
+static AM_gainSetting_t gainAfterGainChange;
+
+static uint32_t numberOfSamplesHandedOff;
+
+static bool externalMicrophoneOfCapture;
+
+/* Following recording file variables */
+
+static bool followingFileOpened;
+
+/* Pre-allocation is skipped for the rest of the wake-up once no contiguous block is found */
+
+static bool contiguousAllocationFailed;
+
+static char followingFilename[MAXIMUM_FILE_NAME_LENGTH];
+
+/* SRAM ring statistics */
+
+static volatile uint32_t numberOfDroppedBuffers;
+
+static volatile uint32_t maximumNumberOfBuffersInUse;
+
 /* Flag to start processing DMA transfers */
 
 static volatile uint32_t numberOfDMATransfers;
 
+static volatile uint32_t numberOfDMATransfersDropped;
+
 static volatile uint32_t numberOfDMATransfersToWait;
 
 /* Compression buffers */
@@ -791,9 +1001,17 @@ static uint8_t firmwareDescription[AM_FIRMWARE_DESCRIPTION_LENGTH] = "AudioMoth-
 
 static void flashLedToIndicateBatteryLife(void);
 
+static void discardFollowingFile(void);
+
+static void preallocateFile(uint32_t effectiveSampleRate, uint32_t duration);
+
+static uint32_t buildRecordingSequence(SC_recordingStep_t *steps, AM_gainSetting_t captureGain, bool gain2RecordingFollows, bool singleCaptureDualGain);
+
+static void compileRecordingTimeline(void);
+
 static void scheduleRecording(uint32_t currentTime, uint32_t *timeOfNextRecordingGain1, uint32_t *durationOfNextRecordingGain1,  uint32_t *timeOfNextRecordingGain2, uint32_t *durationOfNextRecordingGain2, uint32_t *startOfRecordingPeriod, uint32_t *endOfRecordingPeriod);
 
-static AM_recordingState_t makeRecording(uint32_t timeOfNextRecordingGain1, uint32_t recordDurationGain1, AM_gainSetting_t gainOfNextRecording, bool enableLED, AM_extendedBatteryState_t extendedBatteryState, int32_t temperature, uint32_t *fileOpenTime, uint32_t *fileOpenMilliseconds);
+static AM_recordingState_t makeRecording(uint32_t timeOfNextRecordingGain1, uint32_t recordDurationGain1, AM_gainSetting_t gainOfNextRecording, bool deriveSecondaryGain, AM_gainSetting_t secondaryGainOfNextRecording, AM_captureMode_t captureMode, uint32_t timeOfFollowingRecording, uint32_t durationOfFollowingRecording, AM_gainSetting_t gainOfFollowingRecording, bool enableLED, AM_extendedBatteryState_t extendedBatteryState, int32_t temperature, uint32_t *fileOpenTime, uint32_t *fileOpenMilliseconds);
 
 /* Functions of copy to and from the backup domain */
 
@@ -879,6 +1097,18 @@ int main() {
 
         *poweredDownWithShortWaitInterval = false;
 
+        /* Initialise the recording timeline */
+
+        timeline->numberOfEvents = 0;
+
+        /* Initialise the folder cache */
+
+        *cachedFolderIdentity = NO_CACHED_FOLDER;
+
+        *numberedFolderIndex = NO_CACHED_FOLDER;
+
+        *numberOfFilesInNumberedFolder = 0;
+
         /* Copy default deployment ID */
 
         copyToBackupDomain((uint32_t*)deploymentID, (uint8_t*)defaultDeploymentID, DEPLOYMENT_ID_LENGTH);
@@ -935,6 +1165,14 @@ int main() {
 
         *poweredDownWithShortWaitInterval = false;
 
+        /* The SD card may have been changed so the folders must be checked again */
+
+        *cachedFolderIdentity = NO_CACHED_FOLDER;
+
+        *numberedFolderIndex = NO_CACHED_FOLDER;
+
+        AudioMoth_clearFileSystemCache();
+
         /* Check there are active recording periods if the switch is in CUSTOM position */
 
         *readyToMakeRecordings = switchPosition == AM_SWITCH_DEFAULT || (switchPosition == AM_SWITCH_CUSTOM && configSettings->activeRecordingPeriods > 0);
@@ -1066,6 +1304,10 @@ int main() {
 
             if (switchPosition == AM_SWITCH_CUSTOM) {
 
+                /* Compile the recording periods once for this deployment */
+
+                compileRecordingTimeline();
+
                 //sets next times, durations
                 uint32_t timeOfNextEvent = UINT32_MAX;
                 scheduleRecording(scheduleTime, timeOfNextRecordingGain1, durationOfNextRecordingGain1, timeOfNextRecordingGain2, durationOfNextRecordingGain2, &timeOfNextEvent, NULL);
@@ -1178,26 +1420,101 @@ int main() {
 
             if (!fileSystemEnabled) fileSystemEnabled = AudioMoth_enableFileSystem(configSettings->sampleRateDivider == 1 ? AM_SD_CARD_HIGH_SPEED : AM_SD_CARD_NORMAL_SPEED);
 
-            if (fileSystemEnabled)  {
-                recordingState = makeRecording(*timeOfNextRecordingGain1, *durationOfNextRecordingGain1, configSettings->gain1, enableLED, extendedBatteryState, temperature, &fileOpenTimeGain1, &fileOpenMillisecondsGain1);
+            /* In DEFAULT mode the capture can roll over into a new file at a fixed length */
 
-                /* Dual Gain : make a second recording programmatically after the first, with no PowerDown between*/
+            uint32_t rolloverDuration = DEFAULT_MODE_ROLLOVER_DURATION;
+
+            if (DEFAULT_MODE_ROLLOVER_SIZE_IN_MB > 0) {
+
+                uint32_t durationOfRolloverSize = MAX(1, DEFAULT_MODE_ROLLOVER_SIZE_IN_MB * BYTES_IN_MB / NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE / (configSettings->sampleRate / configSettings->sampleRateDivider));
+
+                rolloverDuration = rolloverDuration == 0 ? durationOfRolloverSize : MIN(rolloverDuration, durationOfRolloverSize);
+
+            }
+
+            bool rolloverFiles = switchPosition == AM_SWITCH_DEFAULT && rolloverDuration > 0;
+
+            if (fileSystemEnabled && rolloverFiles) {
+
+                /* Each file hands off to the next without stopping the microphone, DMA or filter, and the next file is opened while the current one streams */
+
+                uint32_t timeOfFile = *timeOfNextRecordingGain1;
+
+                AM_captureMode_t captureMode = HAND_OFF_CAPTURE;
+
+                do {
+
+                    uint32_t *fileOpenTime = captureMode == HAND_OFF_CAPTURE ? &fileOpenTimeGain1 : &fileOpenTimeGain2;
+
+                    uint32_t *fileOpenMilliseconds = captureMode == HAND_OFF_CAPTURE ? &fileOpenMillisecondsGain1 : &fileOpenMillisecondsGain2;
+
+                    recordingState = makeRecording(timeOfFile, rolloverDuration, configSettings->gain1, false, configSettings->gain1, captureMode, timeOfFile + rolloverDuration, rolloverDuration, configSettings->gain1, enableLED, extendedBatteryState, temperature, fileOpenTime, fileOpenMilliseconds);
+
+                    timeOfFile += rolloverDuration;
+
+                    captureMode = CONTINUE_AND_HAND_OFF_CAPTURE;
+
+                } while (recordingState == RECORDING_OKAY);
+
+                discardFollowingFile();
+
+            } else if (fileSystemEnabled)  {
 
                 //check there is an immediately following gain2 recording scheduled , i.e. this is not a period ending on a (partial) recording 1 only
-                if ( switchPosition== AM_SWITCH_CUSTOM &&  recordingState == RECORDING_OKAY &&
-                *timeOfNextRecordingGain2 <= *timeOfNextRecordingGain1+*durationOfNextRecordingGain1+configSettings->sleepDurationBetweenGains+1) {
-                    //make gain2 recording
-                    AudioMoth_enableTemperature();
-                    temperature = AudioMoth_getTemperature();
-                    AudioMoth_disableTemperature();
-
-                    // the function starts immediately; any extra time, the rest of sleepDurationBetweenGains,
-                    // until scheduled recording2 start will be spent inside it,
-                    // in AudioMoth_delay (sleep EM1)
-                    recordingState = makeRecording(*timeOfNextRecordingGain2, *durationOfNextRecordingGain2, configSettings->gain2,  enableLED, extendedBatteryState, temperature, &fileOpenTimeGain2, &fileOpenMillisecondsGain2);
+                bool gain2RecordingFollows = switchPosition == AM_SWITCH_CUSTOM && *timeOfNextRecordingGain2 <= *timeOfNextRecordingGain1 + *durationOfNextRecordingGain1 + configSettings->sleepDurationBetweenGains + 1;
+
+                /* Single capture dual gain : capture at the lower gain and derive the higher gain file digitally, the gain2 slot is then spent asleep */
+
+                bool singleCaptureDualGain = SINGLE_CAPTURE_DUAL_GAIN && ENABLE_24_BIT_OUTPUT == false && gain2RecordingFollows && configSettings->gain1 != configSettings->gain2;
+
+                AM_gainSetting_t captureGain = singleCaptureDualGain ? MIN(configSettings->gain1, configSettings->gain2) : configSettings->gain1;
+
+                AM_gainSetting_t derivedGain = MAX(configSettings->gain1, configSettings->gain2);
+
+                /* Run each step of the sequence back to back. A step which starts as the previous one ends keeps the microphone, DMA and filter running and switches the gain between DMA transfers */
+
+                SC_recordingStep_t steps[MAX_RECORDING_STEPS];
+
+                uint32_t numberOfSteps = buildRecordingSequence(steps, captureGain, gain2RecordingFollows, singleCaptureDualGain);
+
+                bool continueCapture = false;
+
+                for (uint32_t i = 0; i < numberOfSteps && recordingState == RECORDING_OKAY; i += 1) {
+
+                    SC_recordingStep_t *step = steps + i;
+
+                    SC_recordingStep_t *followingStep = i + 1 < numberOfSteps ? steps + i + 1 : NULL;
+
+                    bool deriveSecondaryGain = singleCaptureDualGain && i == 0;
+
+                    bool handOffCapture = GAPLESS_DUAL_GAIN_HANDOFF && deriveSecondaryGain == false && followingStep != NULL && followingStep->time == step->time + step->duration;
+
+                    AM_captureMode_t captureMode = continueCapture ? (handOffCapture ? CONTINUE_AND_HAND_OFF_CAPTURE : CONTINUE_CAPTURE) : (handOffCapture ? HAND_OFF_CAPTURE : INDEPENDENT_CAPTURE);
+
+                    /* The temperature measurement uses the ADC so is skipped while the capture continues */
+
+                    if (i > 0 && continueCapture == false) {
+
+                        AudioMoth_enableTemperature();
+
+                        temperature = AudioMoth_getTemperature();
+
+                        AudioMoth_disableTemperature();
+
+                    }
+
+                    // the function starts immediately; any extra time until the scheduled start of
+                    // the step will be spent inside it, in AudioMoth_delay (EM2 when long enough)
+                    recordingState = makeRecording(step->time, step->duration, step->gain, deriveSecondaryGain, derivedGain, captureMode, followingStep ? followingStep->time : 0, followingStep ? followingStep->duration : 0, followingStep ? followingStep->gain : step->gain, enableLED, extendedBatteryState, temperature, i == 0 ? &fileOpenTimeGain1 : &fileOpenTimeGain2, i == 0 ? &fileOpenMillisecondsGain1 : &fileOpenMillisecondsGain2);
+
+                    continueCapture = handOffCapture;
 
                 }
 
+                /* Remove the file opened in advance if the following step is not made */
+
+                discardFollowingFile();
+
             } else {
 
                 FLASH_LED(Both, LONG_LED_FLASH_DURATION);
@@ -1212,6 +1529,10 @@ int main() {
 
         }
 
+        /* A write error returns from a recording without stopping its capture */
+
+        if (recordingState == SDCARD_WRITE_ERROR) AudioMoth_disableMicrophone();
+
         /* Disable low voltage monitor if it was used */
 
         if (configSettings->enableLowVoltageCutoff) AudioMoth_disableSupplyMonitor();
@@ -1326,12 +1647,12 @@ int main() {
 
     int64_t waitIntervalMilliseconds = WAITING_LED_FLASH_INTERVAL;
 
-    uint32_t waitIntervalSeconds = WAITING_LED_FLASH_INTERVAL / MILLISECONDS_IN_SECOND;
-
-    /* Wait for the next event whilst flashing the LED */
+    /* Wait for the next event whilst flashing the LED. Without a flash the real time clock is set to wake shortly before the event, within the watch dog period, and a switch change wakes the device early */
 
     bool startedRealTimeClock = false;
 
+    uint32_t realTimeClockInterval = 0;
+
     while (true) {
 
         /* Update the time */
@@ -1380,11 +1701,17 @@ int main() {
 
         }
 
-        /* Start the real time clock if it isn't running */
+        /* Start the real time clock, or restart it if the interval has changed, leaving half the wait interval to power down into the event */
 
-        if (startedRealTimeClock == false) {
+        uint32_t interval = shouldFlashLED ? waitIntervalMilliseconds : MIN(timeToEarliestEvent - waitIntervalMilliseconds / 2, MAXIMUM_TICKLESS_WAIT_INTERVAL);
 
-            AudioMoth_startRealTimeClock(waitIntervalSeconds);
+        if (startedRealTimeClock == false || interval != realTimeClockInterval) {
+
+            if (startedRealTimeClock) AudioMoth_stopRealTimeClock();
+
+            AudioMoth_startRealTimeClockMilliseconds(interval);
+
+            realTimeClockInterval = interval;
 
             startedRealTimeClock = true;
 
@@ -1437,9 +1764,27 @@ inline void AudioMoth_handleDirectMemoryAccessInterrupt(bool isPrimaryBuffer, in
 
     if (isPrimaryBuffer) source = primaryBuffer;
 
+    /* Switch the gain for a gapless handoff. The DMA is already filling the next transfer so this is the first at the new gain. The handoff is counted in transfers committed to the SRAM ring so it stays on the file boundary when buffers are dropped */
+
+    if (numberOfDMATransfers - numberOfDMATransfersDropped + 1 == numberOfDMATransfersBeforeGainChange) AudioMoth_setMicrophoneGain(gainRangeOfCapture, gainAfterGainChange);
+
     /* Apply filter to samples */
 
-    bool thresholdExceeded = DigitalFilter_applyFilter(source, buffers[writeBuffer] + writeBufferIndex, configSettings->sampleRateDivider, numberOfRawSamplesInDMATransfer);
+    bool thresholdExceeded;
+
+    if (ENABLE_24_BIT_OUTPUT) {
+
+        thresholdExceeded = DigitalFilter_applyExtendedFilter(source, (uint8_t*)buffers[writeBuffer] + NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE * writeBufferIndex, configSettings->sampleRateDivider, numberOfRawSamplesInDMATransfer);
+
+    } else if (dualGainCapture) {
+
+        thresholdExceeded = DigitalFilter_applyDualGainFilter(source, buffers[writeBuffer] + writeBufferIndex, secondaryBuffers[writeBuffer] + writeBufferIndex, configSettings->sampleRateDivider, numberOfRawSamplesInDMATransfer);
+
+    } else {
+
+        thresholdExceeded = DigitalFilter_applyFilter(source, buffers[writeBuffer] + writeBufferIndex, configSettings->sampleRateDivider, numberOfRawSamplesInDMATransfer);
+
+    }
 
     numberOfDMATransfers += 1;
 
@@ -1451,11 +1796,39 @@ inline void AudioMoth_handleDirectMemoryAccessInterrupt(bool isPrimaryBuffer, in
 
         writeBufferIndex += numberOfRawSamplesInDMATransfer / configSettings->sampleRateDivider;
 
-        if (writeBufferIndex == NUMBER_OF_SAMPLES_IN_BUFFER) {
+        if (writeBufferIndex == numberOfSamplesInBuffer) {
 
             writeBufferIndex = 0;
 
-            writeBuffer = (writeBuffer + 1) & (NUMBER_OF_BUFFERS - 1);
+            uint32_t nextWriteBuffer = (writeBuffer + 1) & (NUMBER_OF_BUFFERS - 1);
+
+            if (nextWriteBuffer == readBuffer) {
+
+                /* The ring is full so drop this buffer rather than overwrite the one being written to the SD card */
+
+                numberOfDroppedBuffers += 1;
+
+                /* Its transfers are removed from the stream, and a gain switch made within them is undone until the stream reaches the handoff again */
+
+                uint32_t numberOfDMATransfersInBuffer = numberOfSamplesInBuffer / (numberOfRawSamplesInDMATransfer / configSettings->sampleRateDivider);
+
+                uint32_t numberOfDMATransfersInStream = numberOfDMATransfers - numberOfDMATransfersDropped;
+
+                bool gainChanged = numberOfDMATransfersBeforeGainChange > 0 && numberOfDMATransfersInStream >= numberOfDMATransfersBeforeGainChange;
+
+                numberOfDMATransfersDropped += numberOfDMATransfersInBuffer;
+
+                if (gainChanged && numberOfDMATransfersInStream - numberOfDMATransfersInBuffer < numberOfDMATransfersBeforeGainChange) AudioMoth_setMicrophoneGain(gainRangeOfCapture, gainBeforeGainChange);
+
+            } else {
+
+                writeBuffer = nextWriteBuffer;
+
+                uint32_t numberOfBuffersInUse = (writeBuffer - readBuffer) & (NUMBER_OF_BUFFERS - 1);
+
+                maximumNumberOfBuffersInUse = MAX(maximumNumberOfBuffersInUse, numberOfBuffersInUse);
+
+            }
 
             writeIndicator[writeBuffer] = false;
 
@@ -1686,161 +2059,529 @@ static void encodeCompressionBuffer(uint32_t numberOfCompressedBuffers) {
 
 }
 
-static void generateFolderAndFilename(char *foldername, char *filename, uint32_t timestamp, AM_gainRange_t gain, bool prefixFoldername) {
-
-    struct tm time;
+/* Generate folder names and filenames */
 
-    time_t rawTime = timestamp + configSettings->timezoneHours * SECONDS_IN_HOUR + configSettings->timezoneMinutes * SECONDS_IN_MINUTE;
+static bool useFolders(void) {
 
-    gmtime_r(&rawTime, &time);
+    return FOLDER_SHARDING != NO_FOLDER_SHARDING || configSettings->enableDailyFolders;
 
-    sprintf(foldername, "%04d%02d%02d", YEAR_OFFSET + time.tm_year, MONTH_OFFSET + time.tm_mon, time.tm_mday);
+}
 
-    uint32_t length = prefixFoldername ? sprintf(filename, "%s/", foldername) : 0;
+static void convertToLocalTime(uint32_t timestamp, struct tm *time) {
 
-    static char *gainSettings[5] = {"Low", "LowMedium", "Medium", "MediumHigh", "High"};
+    time_t rawTime = timestamp + configSettings->timezoneHours * SECONDS_IN_HOUR + configSettings->timezoneMinutes * SECONDS_IN_MINUTE;
 
-    length += sprintf(filename + length, "%s_%02d%02d%02d_gain%s", foldername, time.tm_hour, time.tm_min, time.tm_sec, gainSettings[gain]);
+    gmtime_r(&rawTime, time);
 
-    char *extension = ".WAV";
+}
 
-    strcpy(filename + length, extension);
+static void generateFoldername(char *foldername, uint32_t timestamp) {
 
-}
+    struct tm time;
 
+    convertToLocalTime(timestamp, &time);
 
-/* Save recording to SD card */
+    if (FOLDER_SHARDING == NUMBERED_FOLDERS) {
 
-static AM_recordingState_t makeRecording(uint32_t timeOfNextRecording, uint32_t recordDuration, AM_gainSetting_t gainOfNextRecording, bool enableLED, AM_extendedBatteryState_t extendedBatteryState, int32_t temperature, uint32_t *fileOpenTime, uint32_t *fileOpenMilliseconds) {
+        sprintf(foldername, NUMBERED_FOLDER_FORMAT, *numberedFolderIndex);
 
-    /* Initialise buffers */
+    } else if (FOLDER_SHARDING == HOURLY_FOLDERS) {
 
-    writeBuffer = 0;
+        sprintf(foldername, "%04d%02d%02d/%02d", YEAR_OFFSET + time.tm_year, MONTH_OFFSET + time.tm_mon, time.tm_mday, time.tm_hour);
 
-    writeBufferIndex = 0;
+    } else {
 
-    buffers[0] = (int16_t*)AM_EXTERNAL_SRAM_START_ADDRESS;
+        sprintf(foldername, "%04d%02d%02d", YEAR_OFFSET + time.tm_year, MONTH_OFFSET + time.tm_mon, time.tm_mday);
 
-    for (uint32_t i = 1; i < NUMBER_OF_BUFFERS; i += 1) {
-        buffers[i] = buffers[i - 1] + NUMBER_OF_SAMPLES_IN_BUFFER;
     }
 
-    /* Calculate effective sample rate */
+}
 
-    uint32_t effectiveSampleRate = configSettings->sampleRate / configSettings->sampleRateDivider;
+static void generateFilename(char *filename, char *foldername, uint32_t timestamp, AM_gainRange_t gain) {
 
-    /* Set up the digital filter */
+    struct tm time;
 
-    uint32_t blockingFilterFrequency = configSettings->disable48HzDCBlockingFilter ? LOW_DC_BLOCKING_FREQ : DEFAULT_DC_BLOCKING_FREQ;
+    convertToLocalTime(timestamp, &time);
 
-    requestedFilterType = NO_FILTER;
+    uint32_t length = useFolders() ? sprintf(filename, "%s/", foldername) : 0;
 
-    DigitalFilter_designHighPassFilter(effectiveSampleRate, blockingFilterFrequency);
+    static char *gainSettings[5] = {"Low", "LowMedium", "Medium", "MediumHigh", "High"};
 
-    /* Calculate the sample multiplier */
+    length += sprintf(filename + length, "%04d%02d%02d_%02d%02d%02d_gain%s", YEAR_OFFSET + time.tm_year, MONTH_OFFSET + time.tm_mon, time.tm_mday, time.tm_hour, time.tm_min, time.tm_sec, gainSettings[gain]);
 
-    float sampleMultiplier = 16.0f / (float)(configSettings->oversampleRate * configSettings->sampleRateDivider);
+    char *extension = ".WAV";
 
-    if (AudioMoth_hasInvertedOutput()) sampleMultiplier = -sampleMultiplier;
+    strcpy(filename + length, extension);
 
-    /* Calculate the number of samples in each DMA transfer (while ensuring that number of samples written to the SRAM buffer on each DMA transfer is a power of two so each SRAM buffer is filled after an integer number of DMA transfers) */
+}
 
-    numberOfRawSamplesInDMATransfer = MAXIMUM_SAMPLES_IN_DMA_TRANSFER / configSettings->sampleRateDivider;
+/* Select the numbered folder for the next file. The index and file count are kept in the backup domain so the folders are only searched after the SD card may have changed */
 
-    while (numberOfRawSamplesInDMATransfer & (numberOfRawSamplesInDMATransfer - 1)) {
+static void selectNumberedFolder(void) {
 
-        numberOfRawSamplesInDMATransfer = numberOfRawSamplesInDMATransfer & (numberOfRawSamplesInDMATransfer - 1);
+    if (FOLDER_SHARDING != NUMBERED_FOLDERS) return;
 
-    }
+    if (*numberedFolderIndex == NO_CACHED_FOLDER) {
 
-    numberOfRawSamplesInDMATransfer *= configSettings->sampleRateDivider;
+        static char foldername[MAXIMUM_FILE_NAME_LENGTH];
 
-    /* Initialise termination conditions */
-    microphoneChanged = false;
+        uint32_t index = 0;
 
-    bool supplyVoltageLow = false;
+        while (true) {
 
-    /* Initialise microphone for recording */
+            sprintf(foldername, NUMBERED_FOLDER_FORMAT, index);
 
-    AudioMoth_enableExternalSRAM();
+            if (AudioMoth_doesDirectoryExist(foldername) == false) break;
 
-    AM_gainRange_t gainRange = configSettings->enableLowGainRange ? AM_LOW_GAIN_RANGE : AM_NORMAL_GAIN_RANGE;
+            index += 1;
 
-    bool externalMicrophone = AudioMoth_enableMicrophone(gainRange, gainOfNextRecording, configSettings->clockDivider, configSettings->acquisitionCycles, configSettings->oversampleRate);
+        }
 
-    AudioMoth_initialiseDirectMemoryAccess(primaryBuffer, secondaryBuffer, numberOfRawSamplesInDMATransfer);
+        /* Files may already be in the last existing folder so start a new one */
 
-    /* Show LED for SD card activity */
+        *numberedFolderIndex = index;
 
-    if (enableLED) AudioMoth_setRedLED(true);
+        *numberOfFilesInNumberedFolder = 0;
 
-    /* Open a file with the current local time as the name */
+    }
 
-    static char filename[MAXIMUM_FILE_NAME_LENGTH];
+    if (*numberOfFilesInNumberedFolder >= FILES_PER_NUMBERED_FOLDER) {
 
-    static char foldername[MAXIMUM_FILE_NAME_LENGTH];
+        *numberedFolderIndex += 1;
 
-    generateFolderAndFilename(foldername, filename, timeOfNextRecording, gainOfNextRecording, configSettings->enableDailyFolders);
+        *numberOfFilesInNumberedFolder = 0;
 
-    if (configSettings->enableDailyFolders) {
+    }
 
-        bool directoryExists = AudioMoth_doesDirectoryExist(foldername);
+}
 
-        if (directoryExists == false) FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_makeDirectory(foldername));
+static void countFilesInNumberedFolder(uint32_t numberOfFiles) {
 
-    }
+    if (FOLDER_SHARDING == NUMBERED_FOLDERS) *numberOfFilesInNumberedFolder += numberOfFiles;
 
-    FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_openFile(filename));
+}
 
-    AudioMoth_setRedLED(false);
+/* Create the folder if required. The folder last known to exist is cached so the directory is not searched before every file */
 
-    /* Measure the time difference from the start time */
+static bool prepareFolder(char *foldername, uint32_t timestamp) {
 
-    AudioMoth_getTime(fileOpenTime, fileOpenMilliseconds);
+    if (useFolders() == false) return true;
+
+    uint32_t folderIdentity = *numberedFolderIndex;
+
+    if (FOLDER_SHARDING != NUMBERED_FOLDERS) {
+
+        uint32_t localTime = timestamp + configSettings->timezoneHours * SECONDS_IN_HOUR + configSettings->timezoneMinutes * SECONDS_IN_MINUTE;
+
+        folderIdentity = FOLDER_SHARDING == HOURLY_FOLDERS ? localTime / SECONDS_IN_HOUR : localTime / SECONDS_IN_DAY;
+
+    }
+
+    if (folderIdentity == *cachedFolderIdentity) return true;
+
+    *cachedFolderIdentity = NO_CACHED_FOLDER;
+
+    if (FOLDER_SHARDING == HOURLY_FOLDERS) {
+
+        static char parentFoldername[MAXIMUM_FILE_NAME_LENGTH];
+
+        strcpy(parentFoldername, foldername);
+
+        *strchr(parentFoldername, '/') = 0;
+
+        bool parentDirectoryExists = AudioMoth_doesDirectoryExist(parentFoldername);
+
+        if (parentDirectoryExists == false) RETURN_BOOL_ON_ERROR(AudioMoth_makeDirectory(parentFoldername));
+
+    }
+
+    bool directoryExists = AudioMoth_doesDirectoryExist(foldername);
+
+    if (directoryExists == false) RETURN_BOOL_ON_ERROR(AudioMoth_makeDirectory(foldername));
+
+    *cachedFolderIdentity = folderIdentity;
+
+    return true;
+
+}
+
+/* Open and pre-allocate the file of the following recording */
+
+static bool openFollowingFile(uint32_t timeOfFollowingRecording, uint32_t durationOfFollowingRecording, AM_gainSetting_t gainOfFollowingRecording) {
+
+    static char foldername[MAXIMUM_FILE_NAME_LENGTH];
+
+    selectNumberedFolder();
+
+    generateFoldername(foldername, timeOfFollowingRecording);
+
+    generateFilename(followingFilename, foldername, timeOfFollowingRecording, gainOfFollowingRecording);
+
+    RETURN_BOOL_ON_ERROR(prepareFolder(foldername, timeOfFollowingRecording));
+
+    /* The primary file is reselected whatever the outcome as the current recording is still writing to it */
+
+    AudioMoth_selectFile(AM_FOLLOWING_FILE);
+
+    bool success = AudioMoth_openFile(followingFilename);
+
+    if (success && PREALLOCATE_RECORDING_FILES) {
+
+        uint32_t effectiveSampleRate = configSettings->sampleRate / configSettings->sampleRateDivider;
+
+        preallocateFile(effectiveSampleRate, durationOfFollowingRecording);
+
+    }
+
+    AudioMoth_selectFile(AM_PRIMARY_FILE);
+
+    if (success) countFilesInNumberedFolder(1);
+
+    return success;
+
+}
+
+/* Pre-allocate the selected file. Long or unlimited recordings are capped and grow cluster by cluster past the allocated block */
+
+static void preallocateFile(uint32_t effectiveSampleRate, uint32_t duration) {
+
+    /* A failed search scans the whole FAT or bitmap, so it is not repeated on later files in this wake-up */
+
+    if (contiguousAllocationFailed) return;
+
+    uint32_t fileSize = sizeof(wavHeader_t) + NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE * effectiveSampleRate * MIN(duration, MAXIMUM_PREALLOCATION_DURATION);
+
+    contiguousAllocationFailed = AudioMoth_expandFile(fileSize) == false;
+
+}
+
+/* Close and remove a following file which will not be recorded */
+
+static void discardFollowingFile(void) {
+
+    if (followingFileOpened == false) return;
+
+    AudioMoth_selectFile(AM_FOLLOWING_FILE);
+
+    AudioMoth_closeFile();
+
+    AudioMoth_selectFile(AM_PRIMARY_FILE);
+
+    AudioMoth_deleteFile(followingFilename);
+
+    followingFileOpened = false;
+
+}
+
+
+/* Save recording to SD card */
+
+static AM_recordingState_t makeRecording(uint32_t timeOfNextRecording, uint32_t recordDuration, AM_gainSetting_t gainOfNextRecording, bool deriveSecondaryGain, AM_gainSetting_t secondaryGainOfNextRecording, AM_captureMode_t captureMode, uint32_t timeOfFollowingRecording, uint32_t durationOfFollowingRecording, AM_gainSetting_t gainOfFollowingRecording, bool enableLED, AM_extendedBatteryState_t extendedBatteryState, int32_t temperature, uint32_t *fileOpenTime, uint32_t *fileOpenMilliseconds) {
+
+    /* A continued capture picks up the SRAM ring, DMA transfers and filter state left running by the recording which handed off to it */
+
+    bool continueCapture = captureMode == CONTINUE_CAPTURE || captureMode == CONTINUE_AND_HAND_OFF_CAPTURE;
+
+    bool handOffCapture = captureMode == HAND_OFF_CAPTURE || captureMode == CONTINUE_AND_HAND_OFF_CAPTURE;
+
+    numberOfDMATransfersBeforeGainChange = 0;
+
+    AudioMoth_clearSDCardBusyHistogram();
+
+    /* Initialise buffers. These are contiguous so consecutive buffers can be written to the SD card in one call. A single capture dual gain recording halves each buffer and places the secondary buffers after the primary buffers */
+
+    if (continueCapture == false) {
+
+        numberOfDroppedBuffers = 0;
+
+        maximumNumberOfBuffersInUse = 0;
+
+        writeBuffer = 0;
+
+        writeBufferIndex = 0;
+
+        readBuffer = 0;
+
+        readBufferIndex = 0;
+
+        dualGainCapture = deriveSecondaryGain;
+
+        numberOfSamplesInBuffer = dualGainCapture ? NUMBER_OF_SAMPLES_IN_BUFFER / 2 : NUMBER_OF_SAMPLES_IN_BUFFER;
+
+        uint32_t numberOfBytesInBuffer = NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE * numberOfSamplesInBuffer;
+
+        for (uint32_t i = 0; i < NUMBER_OF_BUFFERS; i += 1) {
+            buffers[i] = (int16_t*)(AM_EXTERNAL_SRAM_START_ADDRESS + i * numberOfBytesInBuffer);
+        }
+
+        if (dualGainCapture) {
+
+            for (uint32_t i = 0; i < NUMBER_OF_BUFFERS; i += 1) {
+                secondaryBuffers[i] = (int16_t*)(AM_EXTERNAL_SRAM_START_ADDRESS + (NUMBER_OF_BUFFERS + i) * numberOfBytesInBuffer);
+            }
+
+        }
+
+    }
+
+    /* Calculate effective sample rate */
+
+    uint32_t effectiveSampleRate = configSettings->sampleRate / configSettings->sampleRateDivider;
+
+    /* Set up the digital filter */
+
+    if (continueCapture == false) {
+
+        uint32_t blockingFilterFrequency = configSettings->disable48HzDCBlockingFilter ? LOW_DC_BLOCKING_FREQ : DEFAULT_DC_BLOCKING_FREQ;
+
+        requestedFilterType = NO_FILTER;
+
+        DigitalFilter_designHighPassFilter(effectiveSampleRate, blockingFilterFrequency);
+
+        DigitalFilter_designDecimationFilter(DECIMATION_FILTER, configSettings->sampleRateDivider);
+
+    }
+
+    /* Calculate the sample multiplier */
+
+    float sampleMultiplier = 16.0f / (float)(configSettings->oversampleRate * configSettings->sampleRateDivider);
+
+    if (AudioMoth_hasInvertedOutput()) sampleMultiplier = -sampleMultiplier;
+
+    /* Calculate the number of samples in each DMA transfer (while ensuring that number of samples written to the SRAM buffer on each DMA transfer is a power of two so each SRAM buffer is filled after an integer number of DMA transfers) */
+
+    numberOfRawSamplesInDMATransfer = MAXIMUM_SAMPLES_IN_DMA_TRANSFER / configSettings->sampleRateDivider;
+
+    while (numberOfRawSamplesInDMATransfer & (numberOfRawSamplesInDMATransfer - 1)) {
+
+        numberOfRawSamplesInDMATransfer = numberOfRawSamplesInDMATransfer & (numberOfRawSamplesInDMATransfer - 1);
+
+    }
+
+    numberOfRawSamplesInDMATransfer *= configSettings->sampleRateDivider;
+
+    /* Initialise termination conditions */
+    microphoneChanged = false;
+
+    bool supplyVoltageLow = false;
+
+    /* Initialise microphone for recording */
+
+    AM_gainRange_t gainRange = configSettings->enableLowGainRange ? AM_LOW_GAIN_RANGE : AM_NORMAL_GAIN_RANGE;
+
+    bool externalMicrophone = externalMicrophoneOfCapture;
+
+    if (continueCapture == false) AudioMoth_enableExternalSRAM();
+
+    /* Show LED for SD card activity */
+
+    if (enableLED) AudioMoth_setRedLED(true);
+
+    /* Open a file with the current local time as the name */
+
+    static char filename[MAXIMUM_FILE_NAME_LENGTH];
+
+    static char foldername[MAXIMUM_FILE_NAME_LENGTH];
+
+    static char secondaryFilename[MAXIMUM_FILE_NAME_LENGTH];
+
+    /* A file opened while the previous recording was streaming only needs to be switched in */
+
+    bool useFollowingFile = followingFileOpened;
 
     /* Calculate time correction for sample rate due to file header */
 
-    uint32_t numberOfSamplesInHeader = sizeof(wavHeader_t) / NUMBER_OF_BYTES_IN_SAMPLE;
+    uint32_t numberOfSamplesInHeader = sizeof(wavHeader_t) / NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE;
 
     int32_t sampleRateTimeOffset = ROUNDED_DIV(numberOfSamplesInHeader * MILLISECONDS_IN_SECOND, effectiveSampleRate);
 
-    /* Calculate time until the recording should start */
+    /* Decide whether the start will be missed before opening the file, allowing FILE_OPEN_ALLOWANCE milliseconds for the open, so the file is named once. It is only renamed if the open takes longer */
 
-    int64_t millisecondsUntilRecordingShouldStart = (int64_t)timeOfNextRecording * MILLISECONDS_IN_SECOND - (int64_t)*fileOpenTime * MILLISECONDS_IN_SECOND - (int64_t)*fileOpenMilliseconds - (int64_t)sampleRateTimeOffset;
+    uint32_t timeOffsetOfFilename = 0;
 
-    /* Calculate the actual recording start time if the intended start has been missed */
+    if (continueCapture == false && useFollowingFile == false) {
 
-    uint32_t timeOffset = millisecondsUntilRecordingShouldStart < 0 ? 1 - millisecondsUntilRecordingShouldStart / MILLISECONDS_IN_SECOND : 0;
+        uint32_t currentTime, currentMilliseconds;
 
-    recordDuration = timeOffset >= recordDuration ? 0 : recordDuration - timeOffset;
+        AudioMoth_getTime(&currentTime, &currentMilliseconds);
 
-    millisecondsUntilRecordingShouldStart += timeOffset * MILLISECONDS_IN_SECOND;
+        int64_t millisecondsUntilFileShouldOpen = (int64_t)timeOfNextRecording * MILLISECONDS_IN_SECOND - (int64_t)currentTime * MILLISECONDS_IN_SECOND - (int64_t)currentMilliseconds - (int64_t)sampleRateTimeOffset - FILE_OPEN_ALLOWANCE;
 
-    /* Calculate the period to wait before starting the DMA transfers */
+        timeOffsetOfFilename = millisecondsUntilFileShouldOpen < 0 ? 1 - millisecondsUntilFileShouldOpen / MILLISECONDS_IN_SECOND : 0;
 
-    uint32_t numberOfRawSamplesPerMillisecond = configSettings->sampleRate / MILLISECONDS_IN_SECOND;
+    }
 
-    uint32_t numberOfRawSamplesToWait = millisecondsUntilRecordingShouldStart * numberOfRawSamplesPerMillisecond;
+    if (useFollowingFile == false) selectNumberedFolder();
 
-    numberOfDMATransfersToWait = numberOfRawSamplesToWait / numberOfRawSamplesInDMATransfer;
+    generateFoldername(foldername, timeOfNextRecording + timeOffsetOfFilename);
 
-    uint32_t remainingNumberOfRawSamples = numberOfRawSamplesToWait % numberOfRawSamplesInDMATransfer;
+    generateFilename(filename, foldername, timeOfNextRecording + timeOffsetOfFilename, gainOfNextRecording);
 
-    uint32_t remainingMillisecondsToWait = ROUNDED_DIV(remainingNumberOfRawSamples, numberOfRawSamplesPerMillisecond);
+    if (dualGainCapture) generateFilename(secondaryFilename, foldername, timeOfNextRecording + timeOffsetOfFilename, secondaryGainOfNextRecording);
 
-    /* Calculate updated recording parameters */
+    AudioMoth_selectFile(AM_PRIMARY_FILE);
+
+    if (useFollowingFile) {
+
+        AudioMoth_swapFiles(AM_PRIMARY_FILE, AM_FOLLOWING_FILE);
+
+        followingFileOpened = false;
+
+    } else {
+
+        FLASH_LED_AND_RETURN_ON_ERROR(prepareFolder(foldername, timeOfNextRecording + timeOffsetOfFilename));
+
+        FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_openFile(filename));
+
+        if (dualGainCapture) {
+
+            AudioMoth_selectFile(AM_SECONDARY_FILE);
+
+            FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_openFile(secondaryFilename));
+
+            AudioMoth_selectFile(AM_PRIMARY_FILE);
+
+        }
+
+        countFilesInNumberedFolder(dualGainCapture ? 2 : 1);
+
+    }
+
+    /* Pre-allocate a contiguous block of clusters for the recording so no FAT or bitmap updates are made while recording. The files are truncated to their actual length when closed and grow cluster by cluster if no contiguous block is found */
+
+    uint32_t maximumNumberOfSeconds = (MAXIMUM_WAV_FILE_SIZE - sizeof(wavHeader_t)) / NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE / effectiveSampleRate;
+
+    if (PREALLOCATE_RECORDING_FILES && useFollowingFile == false) {
+
+        preallocateFile(effectiveSampleRate, recordDuration);
+
+        if (dualGainCapture) {
+
+            AudioMoth_selectFile(AM_SECONDARY_FILE);
+
+            preallocateFile(effectiveSampleRate, recordDuration);
+
+            AudioMoth_selectFile(AM_PRIMARY_FILE);
+
+        }
+
+    }
+
+    /* A continued capture has no samples before its start time to hide under the header so the header is given its own space */
+
+    if (continueCapture) FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_seekInFile(sizeof(wavHeader_t)));
+
+    AudioMoth_setRedLED(false);
+
+    /* Measure the time difference from the start time */
+
+    AudioMoth_getTime(fileOpenTime, fileOpenMilliseconds);
+
+    /* A continued capture is already running so starts without waiting */
+
+    uint32_t timeOffset = 0;
+
+    uint32_t remainingMillisecondsToWait = 0;
+
+    if (continueCapture == false) {
+
+        /* Calculate time until the recording should start */
+
+        int64_t millisecondsUntilRecordingShouldStart = (int64_t)timeOfNextRecording * MILLISECONDS_IN_SECOND - (int64_t)*fileOpenTime * MILLISECONDS_IN_SECOND - (int64_t)*fileOpenMilliseconds - (int64_t)sampleRateTimeOffset;
+
+        /* Calculate the actual recording start time if the intended start has been missed */
+
+        timeOffset = millisecondsUntilRecordingShouldStart < 0 ? 1 - millisecondsUntilRecordingShouldStart / MILLISECONDS_IN_SECOND : 0;
+
+        timeOffset = MAX(timeOffset, timeOffsetOfFilename);
+
+        recordDuration = timeOffset >= recordDuration ? 0 : recordDuration - timeOffset;
+
+        millisecondsUntilRecordingShouldStart += timeOffset * MILLISECONDS_IN_SECOND;
+
+        /* Sleep until shortly before the start so the microphone is only powered, and DMA transfers only discarded, for the warm up period */
+
+        if (millisecondsUntilRecordingShouldStart > MICROPHONE_WARM_UP_PERIOD) {
 
-    uint32_t maximumNumberOfSeconds = (MAXIMUM_WAV_FILE_SIZE - sizeof(wavHeader_t)) / NUMBER_OF_BYTES_IN_SAMPLE / effectiveSampleRate;
+            AudioMoth_delay(millisecondsUntilRecordingShouldStart - MICROPHONE_WARM_UP_PERIOD);
+
+            uint32_t currentTime, currentMilliseconds;
+
+            AudioMoth_getTime(&currentTime, &currentMilliseconds);
+
+            millisecondsUntilRecordingShouldStart = (int64_t)(timeOfNextRecording + timeOffset) * MILLISECONDS_IN_SECOND - (int64_t)currentTime * MILLISECONDS_IN_SECOND - (int64_t)currentMilliseconds - (int64_t)sampleRateTimeOffset;
+
+            millisecondsUntilRecordingShouldStart = MAX(0, millisecondsUntilRecordingShouldStart);
+
+        }
+
+        externalMicrophone = AudioMoth_enableMicrophone(gainRange, gainOfNextRecording, configSettings->clockDivider, configSettings->acquisitionCycles, configSettings->oversampleRate);
+
+        /* Set the digital gain which takes the captured gain to the secondary gain */
+
+        if (dualGainCapture) DigitalFilter_setSecondaryGain(analogGains[gainRange][secondaryGainOfNextRecording] / analogGains[gainRange][gainOfNextRecording]);
+
+        AudioMoth_initialiseDirectMemoryAccess(primaryBuffer, secondaryBuffer, numberOfRawSamplesInDMATransfer);
+
+        /* Calculate the period to wait before starting the DMA transfers */
+
+        uint32_t numberOfRawSamplesPerMillisecond = configSettings->sampleRate / MILLISECONDS_IN_SECOND;
+
+        uint32_t numberOfRawSamplesToWait = millisecondsUntilRecordingShouldStart * numberOfRawSamplesPerMillisecond;
+
+        numberOfDMATransfersToWait = numberOfRawSamplesToWait / numberOfRawSamplesInDMATransfer;
+
+        uint32_t remainingNumberOfRawSamples = numberOfRawSamplesToWait % numberOfRawSamplesInDMATransfer;
+
+        remainingMillisecondsToWait = ROUNDED_DIV(remainingNumberOfRawSamples, numberOfRawSamplesPerMillisecond);
+
+    }
+
+    /* Calculate updated recording parameters */
 
     bool fileSizeLimited = (recordDuration > maximumNumberOfSeconds);
 
     uint32_t numberOfSamples = effectiveSampleRate * (fileSizeLimited ? maximumNumberOfSeconds : recordDuration);
 
-    /* Initialise main loop variables */
+    /* The samples already written by the recording which handed off are removed so the continued capture ends on schedule */
+
+    if (continueCapture) numberOfSamples = numberOfSamples > numberOfSamplesHandedOff ? numberOfSamples - numberOfSamplesHandedOff : 0;
+
+    /* When handing off, extend the recording to the end of the DMA transfer and the whole number of sectors in which it ends and switch the gain, if it changes, from the following transfer. A continued capture starts on a DMA transfer and sector boundary, so its writes stay sector aligned, and has no samples under its header. Both block sizes are powers of two so the larger is a multiple of the smaller */
+
+    if (handOffCapture && fileSizeLimited == false) {
 
-    uint32_t readBuffer = 0;
+        uint32_t numberOfSamplesInDMATransfer = numberOfRawSamplesInDMATransfer / configSettings->sampleRateDivider;
 
-    uint32_t samplesWritten = 0;
+        uint32_t numberOfSamplesInHandOffBlock = MAX(numberOfSamplesInDMATransfer, NUMBER_OF_SAMPLES_IN_SECTOR_BLOCK);
+
+        uint32_t numberOfSamplesInStream = (continueCapture ? 0 : numberOfSamplesInHeader) + numberOfSamples;
+
+        uint32_t numberOfSamplesInHandOffStream = ROUNDED_UP_DIV(numberOfSamplesInStream, numberOfSamplesInHandOffBlock) * numberOfSamplesInHandOffBlock;
+
+        uint32_t numberOfDMATransfersInRecording = numberOfSamplesInHandOffStream / numberOfSamplesInDMATransfer;
+
+        numberOfSamplesHandedOff = numberOfSamplesInHandOffStream - numberOfSamplesInStream;
+
+        numberOfSamples += numberOfSamplesHandedOff;
+
+        gainRangeOfCapture = gainRange;
+
+        gainBeforeGainChange = gainOfNextRecording;
+
+        gainAfterGainChange = gainOfFollowingRecording;
+
+        externalMicrophoneOfCapture = externalMicrophone;
+
+        numberOfDMATransfersAtHandoff = (continueCapture ? numberOfDMATransfersAtHandoff : numberOfDMATransfersToWait) + numberOfDMATransfersInRecording;
+
+        if (gainOfFollowingRecording != gainOfNextRecording) numberOfDMATransfersBeforeGainChange = numberOfDMATransfersAtHandoff;
+
+    }
+
+    /* Initialise main loop variables */
+
+    uint32_t samplesWritten = continueCapture ? numberOfSamplesInHeader : 0;
 
     uint32_t buffersProcessed = 0;
 
@@ -1852,13 +2593,21 @@ static AM_recordingState_t makeRecording(uint32_t timeOfNextRecording, uint32_t
 
     bool triggerHasOccurred = false;
 
+    bool followingFileRequested = durationOfFollowingRecording > 0;
+
     /* Start processing DMA transfers */
 
-    numberOfDMATransfers = 0;
+    if (continueCapture == false) {
+
+        numberOfDMATransfers = 0;
+
+        numberOfDMATransfersDropped = 0;
 
-    AudioMoth_delay(remainingMillisecondsToWait);
+        AudioMoth_delay(remainingMillisecondsToWait);
 
-    AudioMoth_startMicrophoneSamples(configSettings->sampleRate);
+        AudioMoth_startMicrophoneSamples(configSettings->sampleRate);
+
+    }
 
     /* Main recording loop */
 
@@ -1866,11 +2615,7 @@ static AM_recordingState_t makeRecording(uint32_t timeOfNextRecording, uint32_t
 
         while (readBuffer != writeBuffer && samplesWritten < numberOfSamples + numberOfSamplesInHeader && !microphoneChanged && !switchPositionChanged  && !supplyVoltageLow) {
 
-            /* Determine the appropriate number of bytes to the SD card */
-
-            uint32_t numberOfSamplesToWrite = MIN(numberOfSamples + numberOfSamplesInHeader - samplesWritten, NUMBER_OF_SAMPLES_IN_BUFFER);
-
-           /* Check if this buffer should actually be written to the SD card */
+            /* Check if this buffer should actually be written to the SD card */
 
             bool writeIndicated = writeIndicator[readBuffer];
 
@@ -1880,13 +2625,35 @@ static AM_recordingState_t makeRecording(uint32_t timeOfNextRecording, uint32_t
 
             numberOfTriggeredBuffersWritten = writeIndicated ? 0 : numberOfTriggeredBuffersWritten + 1;
 
-            bool shouldWriteThisSector = writeIndicated;
+            /* Compressed and blank buffers are only encoded as 16-bit samples in a single file */
+
+            bool shouldWriteThisSector = writeIndicated || dualGainCapture || ENABLE_24_BIT_OUTPUT;
+
+            /* Coalesce the following ready buffers which should also be written. This stops at the end of the ring so a wrap takes a second write */
+
+            uint32_t numberOfBuffersToWrite = 1;
+
+            if (shouldWriteThisSector) {
+
+                while (numberOfBuffersToWrite < MAXIMUM_NUMBER_OF_BUFFERS_IN_WRITE && readBuffer + numberOfBuffersToWrite < NUMBER_OF_BUFFERS && readBuffer + numberOfBuffersToWrite != writeBuffer) {
+
+                    if (writeIndicator[readBuffer + numberOfBuffersToWrite] == false && dualGainCapture == false && ENABLE_24_BIT_OUTPUT == false) break;
+
+                    numberOfBuffersToWrite += 1;
+
+                }
+
+            }
+
+            /* Determine the appropriate number of bytes to the SD card. A handoff can leave the read position part way through a buffer */
+
+            uint32_t numberOfSamplesToWrite = MIN(numberOfSamples + numberOfSamplesInHeader - samplesWritten, numberOfBuffersToWrite * numberOfSamplesInBuffer - readBufferIndex);
 
             /* Compress the buffer or write the buffer to SD card */
 
-            if (shouldWriteThisSector == false && buffersProcessed > 0 && numberOfSamplesToWrite == NUMBER_OF_SAMPLES_IN_BUFFER) {
+            if (shouldWriteThisSector == false && buffersProcessed > 0 && numberOfSamplesToWrite == numberOfSamplesInBuffer) {
 
-                numberOfCompressedBuffers += NUMBER_OF_BYTES_IN_SAMPLE * NUMBER_OF_SAMPLES_IN_BUFFER / COMPRESSION_BUFFER_SIZE_IN_BYTES;
+                numberOfCompressedBuffers += NUMBER_OF_BYTES_IN_SAMPLE * numberOfSamplesInBuffer / COMPRESSION_BUFFER_SIZE_IN_BYTES;
 
             } else {
 
@@ -1912,7 +2679,17 @@ static AM_recordingState_t makeRecording(uint32_t timeOfNextRecording, uint32_t
 
                 if (shouldWriteThisSector) {
 
-                    FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_writeToFile(buffers[readBuffer], NUMBER_OF_BYTES_IN_SAMPLE * numberOfSamplesToWrite));
+                    FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_writeToFile((uint8_t*)buffers[readBuffer] + NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE * readBufferIndex, NUMBER_OF_BYTES_IN_OUTPUT_SAMPLE * numberOfSamplesToWrite));
+
+                    if (dualGainCapture) {
+
+                        AudioMoth_selectFile(AM_SECONDARY_FILE);
+
+                        FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_writeToFile(secondaryBuffers[readBuffer] + readBufferIndex, NUMBER_OF_BYTES_IN_SAMPLE * numberOfSamplesToWrite));
+
+                        AudioMoth_selectFile(AM_PRIMARY_FILE);
+
+                    }
 
                 } else {
 
@@ -1940,11 +2717,29 @@ static AM_recordingState_t makeRecording(uint32_t timeOfNextRecording, uint32_t
 
             /* Increment buffer counters */
 
-            readBuffer = (readBuffer + 1) & (NUMBER_OF_BUFFERS - 1);
+            uint32_t numberOfSamplesRead = readBufferIndex + numberOfSamplesToWrite;
+
+            readBuffer = (readBuffer + numberOfSamplesRead / numberOfSamplesInBuffer) & (NUMBER_OF_BUFFERS - 1);
+
+            readBufferIndex = numberOfSamplesRead % numberOfSamplesInBuffer;
 
             samplesWritten += numberOfSamplesToWrite;
 
-            buffersProcessed += 1;
+            buffersProcessed += numberOfBuffersToWrite;
+
+        }
+
+        /* Open the file of the following recording once this one is streaming so the SRAM buffers absorb the latency */
+
+        if (followingFileRequested && samplesWritten > 0) {
+
+            if (enableLED) AudioMoth_setRedLED(true);
+
+            followingFileOpened = openFollowingFile(timeOfFollowingRecording, durationOfFollowingRecording, gainOfFollowingRecording);
+
+            AudioMoth_setRedLED(false);
+
+            followingFileRequested = false;
 
         }
 
@@ -1962,6 +2757,12 @@ static AM_recordingState_t makeRecording(uint32_t timeOfNextRecording, uint32_t
 
     }
 
+    /* Stop the capture unless it continues into the following recording, so no samples reach the buffers, and the ADC and DMA transfers are not left running, while the next recording waits to start */
+
+    bool captureContinues = handOffCapture && fileSizeLimited == false && !microphoneChanged && !switchPositionChanged && !supplyVoltageLow;
+
+    if (captureContinues == false) AudioMoth_disableMicrophone();
+
     /* Write the compression buffer files at the end */
 
     if (samplesWritten < numberOfSamples + numberOfSamplesInHeader && numberOfCompressedBuffers > 0) {
@@ -1984,6 +2785,20 @@ static AM_recordingState_t makeRecording(uint32_t timeOfNextRecording, uint32_t
 
     }
 
+    /* Take the SRAM ring statistics for this recording. After a handoff the counts restart for the continued capture */
+
+    uint32_t droppedBuffers = numberOfDroppedBuffers;
+
+    uint32_t maximumBuffersInUse = maximumNumberOfBuffersInUse;
+
+    if (handOffCapture) {
+
+        numberOfDroppedBuffers = 0;
+
+        maximumNumberOfBuffersInUse = 0;
+
+    }
+
     /* Determine recording state */
 
     AM_recordingState_t recordingState = microphoneChanged ? MICROPHONE_CHANGED :
@@ -1998,12 +2813,14 @@ static AM_recordingState_t makeRecording(uint32_t timeOfNextRecording, uint32_t
 
     setHeaderDetails(&wavHeader, effectiveSampleRate, samplesWritten - numberOfSamplesInHeader - totalNumberOfCompressedSamples);
 
-    setHeaderComment(&wavHeader, configSettings, timeOfNextRecording + timeOffset, (uint8_t*)AM_UNIQUE_ID_START_ADDRESS, deploymentID, defaultDeploymentID, extendedBatteryState, temperature, gainOfNextRecording, externalMicrophone, recordingState);
+    setHeaderComment(&wavHeader, configSettings, timeOfNextRecording + timeOffset, (uint8_t*)AM_UNIQUE_ID_START_ADDRESS, deploymentID, defaultDeploymentID, extendedBatteryState, temperature, gainOfNextRecording, gainOfNextRecording, externalMicrophone, droppedBuffers, maximumBuffersInUse, recordingState);
 
     /* Write the header */
 
     if (enableLED) AudioMoth_setRedLED(true);
 
+    FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_truncateFile());
+
     FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_seekInFile(0));
 
     FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_writeToFile(&wavHeader, sizeof(wavHeader_t)));
@@ -2012,295 +2829,161 @@ static AM_recordingState_t makeRecording(uint32_t timeOfNextRecording, uint32_t
 
     FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_closeFile());
 
-    AudioMoth_setRedLED(false);
-
-    /* Rename the file if necessary */
+    /* Write the header of the derived gain file and close it */
 
-    static char newFilename[MAXIMUM_FILE_NAME_LENGTH];
-
-    if (timeOffset > 0) {
+    if (dualGainCapture) {
 
-        generateFolderAndFilename(foldername, newFilename, timeOfNextRecording + timeOffset, gainOfNextRecording, configSettings->enableDailyFolders);
+        setHeaderComment(&wavHeader, configSettings, timeOfNextRecording + timeOffset, (uint8_t*)AM_UNIQUE_ID_START_ADDRESS, deploymentID, defaultDeploymentID, extendedBatteryState, temperature, secondaryGainOfNextRecording, gainOfNextRecording, externalMicrophone, droppedBuffers, maximumBuffersInUse, recordingState);
 
-        if (enableLED) AudioMoth_setRedLED(true);
+        AudioMoth_selectFile(AM_SECONDARY_FILE);
 
-        FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_renameFile(filename, newFilename));
+        FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_truncateFile());
 
-        AudioMoth_setRedLED(false);
+        FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_seekInFile(0));
 
-    }
+        FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_writeToFile(&wavHeader, sizeof(wavHeader_t)));
 
-    /* Return recording state */
+        FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_closeFile());
 
-    return recordingState;
-
-}
-
-/* Schedule recordings */
-
-static void adjustRecordingDuration(uint32_t *duration, uint32_t recordDuration1, uint32_t recordDuration2, uint32_t sleepDuration, uint32_t sleepDurationBetweenGains) {
-    //this cuts the recording period down to not include any final sleep phase
-
-    uint32_t durationOfCycle = recordDuration1 + recordDuration2 + sleepDuration + sleepDurationBetweenGains;
-
-    uint32_t numberOfCycles = *duration / durationOfCycle;
-
-    uint32_t partialCycle = *duration % durationOfCycle;
-
-    if (partialCycle == 0) {
-
-        *duration = *duration > sleepDuration ? *duration - sleepDuration : 0;
-
-    } else {
-
-        *duration = MIN(*duration, numberOfCycles * durationOfCycle + recordDuration1 + sleepDurationBetweenGains + recordDuration2);
-
-    }
-
-}
-
-static void calculateStartAndDuration(uint32_t currentTime, uint32_t currentSeconds, recordingPeriod_t *period, uint32_t *startTime, uint32_t *duration) {
-
-    *startTime = currentTime - currentSeconds + SECONDS_IN_MINUTE * period->startMinutes;
-
-    *duration = period->endMinutes <= period->startMinutes ? MINUTES_IN_DAY + period->endMinutes - period->startMinutes : period->endMinutes - period->startMinutes;
-
-    *duration *= SECONDS_IN_MINUTE;
-
-}
-
-/* sets timeOfNextRecording, durationOfNextRecording */
-static void scheduleRecording(uint32_t currentTime, uint32_t *timeOfNextRecordingGain1, uint32_t *durationOfNextRecordingGain1, uint32_t *timeOfNextRecordingGain2, uint32_t *durationOfNextRecordingGain2, uint32_t *startOfRecordingPeriod, uint32_t *endOfRecordingPeriod) {
-
-    /* Enforce minumum schedule date */
-
-    currentTime = MAX(currentTime, START_OF_CENTURY);
-
-    /* Check if recording should be limited by earliest recording time */
-
-    if (configSettings->earliestRecordingTime > 0) {
-
-        currentTime = MAX(currentTime, configSettings->earliestRecordingTime);
+        AudioMoth_selectFile(AM_PRIMARY_FILE);
 
     }
 
-    /* No suitable recording periods */
-
-    uint32_t activeRecordingPeriods = MIN(configSettings->activeRecordingPeriods, MAX_RECORDING_PERIODS);
-
-    if (activeRecordingPeriods == 0) {
-
-        *timeOfNextRecordingGain1 = UINT32_MAX;
-
-        *timeOfNextRecordingGain2 = UINT32_MAX;
-
-        if (startOfRecordingPeriod) *startOfRecordingPeriod = UINT32_MAX;
-
-        if (endOfRecordingPeriod) *endOfRecordingPeriod = UINT32_MAX;
-
-        *durationOfNextRecordingGain1 = 0;
-
-        *durationOfNextRecordingGain2 = 0;
-
-        return;
-
-    }
-
-    /* Calculate the number of seconds of this day */
-
-    time_t rawTime = currentTime;
-
-    struct tm *time = gmtime(&rawTime);
-
-    uint32_t currentSeconds = SECONDS_IN_HOUR * time->tm_hour + SECONDS_IN_MINUTE * time->tm_min + time->tm_sec;
-
-    /* Check the last active period on the previous day */
-
-    recordingPeriod_t *lastPeriod = configSettings->recordingPeriods + configSettings->activeRecordingPeriods - 1;
+    AudioMoth_setRedLED(false);
 
-    uint32_t startTime, duration;
+    /* Rename the file if opening it took longer than allowed and the start was missed */
 
-    calculateStartAndDuration(currentTime - SECONDS_IN_DAY, currentSeconds, lastPeriod, &startTime, &duration);
-    //of last period
+    static char newFilename[MAXIMUM_FILE_NAME_LENGTH];
 
-    if (configSettings->disableSleepRecordCycle == false) {
+    bool renameFile = timeOffset > timeOffsetOfFilename;
 
-        adjustRecordingDuration(&duration, configSettings->recordDurationGain1, configSettings->recordDurationGain2, configSettings->sleepDuration, configSettings->sleepDurationBetweenGains);
+    if (renameFile) {
 
-    }
+        /* The file stays in the folder it was created in */
 
-    if (currentTime < startTime + duration && duration > 0) goto done;  //*lastperiod is the recording phase we're still in
+        generateFilename(newFilename, foldername, timeOfNextRecording + timeOffset, gainOfNextRecording);
 
-    /* Check each active recording period on the same day*/
-    // else
-    // if not currently in the *lastperiod recording period, identify next one
-    for (uint32_t i = 0; i < activeRecordingPeriods; i += 1) {
+        if (enableLED) AudioMoth_setRedLED(true);
 
-        recordingPeriod_t *currentPeriod = configSettings->recordingPeriods + i;
+        FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_renameFile(filename, newFilename));
 
-        calculateStartAndDuration(currentTime, currentSeconds, currentPeriod, &startTime, &duration);
+        if (dualGainCapture) {
 
-        if (configSettings->disableSleepRecordCycle == false) {
+            generateFilename(newFilename, foldername, timeOfNextRecording + timeOffset, secondaryGainOfNextRecording);
 
-            adjustRecordingDuration(&duration, configSettings->recordDurationGain1, configSettings->recordDurationGain2, configSettings->sleepDuration, configSettings->sleepDurationBetweenGains);
+            FLASH_LED_AND_RETURN_ON_ERROR(AudioMoth_renameFile(secondaryFilename, newFilename));
 
         }
 
-        if (currentTime < startTime + duration && duration > 0) goto done;  //*pointer is at next or current period
-
-    }
-
-    /* Calculate time until first period tomorrow */
-
-    recordingPeriod_t *firstPeriod = configSettings->recordingPeriods;
-
-    calculateStartAndDuration(currentTime + SECONDS_IN_DAY, currentSeconds, firstPeriod, &startTime, &duration);
-
-    if (configSettings->disableSleepRecordCycle == false) {
-
-        adjustRecordingDuration(&duration, configSettings->recordDurationGain1, configSettings->recordDurationGain2, configSettings->sleepDuration, configSettings->sleepDurationBetweenGains);
+        AudioMoth_setRedLED(false);
 
     }
 
-done:  //start and duration of current/next period have been identified at startTime, duration
-
-    /* Set the time for start and end of the recording period */
+    /* Append the recording statistics */
 
-    if (startOfRecordingPeriod) *startOfRecordingPeriod = startTime;
+    if (WRITE_RECORDING_STATISTICS) {
 
-    if (endOfRecordingPeriod) *endOfRecordingPeriod = startTime + duration;
-
-    /* Resolve sleep and record cycle */
-
-    if (configSettings->disableSleepRecordCycle) {
+        uint32_t busyHistogram[AM_SD_CARD_BUSY_HISTOGRAM_BINS];
 
-        // if sleep record cycle disabled there will be one long recording at gain1
-        // for the whole recording period
+        AudioMoth_getSDCardBusyHistogram(busyHistogram);
 
-        *timeOfNextRecordingGain1 = startTime;
-
-        *durationOfNextRecordingGain1 = duration;
-
-        *timeOfNextRecordingGain2 = UINT32_MAX;
-
-        *durationOfNextRecordingGain2 = 0;
-
-    } else {
-
-        if (currentTime <= startTime) {
-
-            /* Recording should start at the start of the recording period */
+        if (enableLED) AudioMoth_setRedLED(true);
 
-            *timeOfNextRecordingGain1 = startTime;
+        FLASH_LED_AND_RETURN_ON_ERROR(writeStatisticsToFile(renameFile ? newFilename : filename, samplesWritten - numberOfSamplesInHeader - totalNumberOfCompressedSamples, droppedBuffers, maximumBuffersInUse, busyHistogram));
 
-            *durationOfNextRecordingGain1 = MIN(duration, configSettings->recordDurationGain1);
+        AudioMoth_setRedLED(false);
 
-            // midnight bug source - fixed
-            if (duration >=  configSettings->sleepDurationBetweenGains + configSettings->recordDurationGain1){ //at least some of Gain2 recording fits in period
+    }
 
-                *timeOfNextRecordingGain2 = startTime + configSettings->sleepDurationBetweenGains +configSettings->recordDurationGain1; //start after recording 1 and sleepBetween
+    /* Return recording state */
 
-                *durationOfNextRecordingGain2 = MIN(duration - configSettings->recordDurationGain1 - configSettings-> sleepDurationBetweenGains, configSettings->recordDurationGain2); //run for full time or rest of period
-            } else {
+    return recordingState;
 
-                *timeOfNextRecordingGain2 = UINT32_MAX; //never (a far future date in 2106)
+}
 
-                *durationOfNextRecordingGain2 = 0;
+/* Schedule recordings */
 
-            }
+static void getScheduleSettings(SC_settings_t *settings) {
 
-        } else { //we are currently somewhere in a recording period
+    settings->recordDurationGain1 = configSettings->recordDurationGain1;
 
-            /* Recording should start immediately or at the start of the next recording cycle */
+    settings->sleepDurationBetweenGains = configSettings->sleepDurationBetweenGains;
 
-            uint32_t secondsFromStartOfPeriod = currentTime - startTime;
+    settings->recordDurationGain2 = configSettings->recordDurationGain2;
 
-            //figure out what recording/sleep phase were in by looking at current time
+    settings->sleepDuration = configSettings->sleepDuration;
 
-            uint32_t durationOfCycle = configSettings->recordDurationGain1 + configSettings->sleepDurationBetweenGains + configSettings->recordDurationGain2 + configSettings->sleepDuration;
+    Schedule_setAdditionalGainSteps(settings, additionalGainSteps, MAX_ADDITIONAL_GAIN_STEPS);
 
-            uint32_t partialCycle = secondsFromStartOfPeriod % durationOfCycle;  //where we are in the recordGain1 - recordGain2 - sleep cycle
+    settings->disableSleepRecordCycle = configSettings->disableSleepRecordCycle;
 
-            *timeOfNextRecordingGain1 = currentTime - partialCycle;
+    settings->earliestRecordingTime = configSettings->earliestRecordingTime;
 
-            *timeOfNextRecordingGain2 = currentTime - partialCycle + configSettings->recordDurationGain1 + configSettings->sleepDurationBetweenGains;
+    settings->latestRecordingTime = configSettings->latestRecordingTime;
 
-            if (partialCycle >= configSettings->recordDurationGain1) { //we're past first gain recording
+    settings->activeRecordingPeriods = configSettings->activeRecordingPeriods;
 
-                /* Wait for next cycle to begin */
+    settings->recordingPeriods = configSettings->recordingPeriods;
 
-                *timeOfNextRecordingGain1 += durationOfCycle;
+}
 
-                if (partialCycle >= configSettings->recordDurationGain1 + configSettings->sleepDurationBetweenGains + configSettings->recordDurationGain2) { //we're also past second gain recording
+static void compileRecordingTimeline(void) {
 
-                    *timeOfNextRecordingGain2 += durationOfCycle;
+    SC_settings_t settings;
 
-                }
+    getScheduleSettings(&settings);
 
-            }
+    Schedule_compileTimeline(&settings, timeline);
 
-            uint32_t remainingDuration = startTime + duration - *timeOfNextRecordingGain1; //of period, for next recording
+}
 
-           *durationOfNextRecordingGain1 = MIN(remainingDuration, configSettings->recordDurationGain1);
+static void scheduleRecording(uint32_t currentTime, uint32_t *timeOfNextRecordingGain1, uint32_t *durationOfNextRecordingGain1, uint32_t *timeOfNextRecordingGain2, uint32_t *durationOfNextRecordingGain2, uint32_t *startOfRecordingPeriod, uint32_t *endOfRecordingPeriod) {
 
-            if (remainingDuration >= configSettings->recordDurationGain1 + configSettings->sleepDurationBetweenGains){ //at least some of Gain2 recording fits in period
+    SC_settings_t settings;
 
-                *durationOfNextRecordingGain2 = MIN(remainingDuration - configSettings->recordDurationGain1 - configSettings->sleepDurationBetweenGains, configSettings->recordDurationGain2);
-            }
-            else{
+    getScheduleSettings(&settings);
 
-                *durationOfNextRecordingGain2 =0;
-            }
+    Schedule_scheduleRecording(&settings, timeline, currentTime, timeOfNextRecordingGain1, durationOfNextRecordingGain1, timeOfNextRecordingGain2, durationOfNextRecordingGain2, startOfRecordingPeriod, endOfRecordingPeriod);
 
+}
 
-        }
+/* Build the sequence of recordings made in one wake-up */
 
-    }
+static uint32_t buildRecordingSequence(SC_recordingStep_t *steps, AM_gainSetting_t captureGain, bool gain2RecordingFollows, bool singleCaptureDualGain) {
 
-    /* Check if recording should be limited by last recording time */
+    steps[0].time = *timeOfNextRecordingGain1;
 
-    uint32_t latestRecordingTime = configSettings->latestRecordingTime > 0 ? configSettings->latestRecordingTime : MIDPOINT_OF_CENTURY;
+    steps[0].duration = *durationOfNextRecordingGain1;
 
-    if (*timeOfNextRecordingGain1 >= latestRecordingTime) {
+    steps[0].gain = captureGain;
 
-        *timeOfNextRecordingGain1 = UINT32_MAX;
+    uint32_t numberOfSteps = 1;
 
-        if (startOfRecordingPeriod) *startOfRecordingPeriod = UINT32_MAX;
+    if (gain2RecordingFollows == false) return numberOfSteps;
 
-        if (endOfRecordingPeriod) *endOfRecordingPeriod = UINT32_MAX;
+    /* The gain2 recording is derived from the gain1 capture in single capture dual gain mode */
 
-        *durationOfNextRecordingGain1 = 0;
+    if (singleCaptureDualGain == false) {
 
-    } else {
+        steps[1].time = *timeOfNextRecordingGain2;
 
-        int64_t excessTime = (int64_t)*timeOfNextRecordingGain1 + (int64_t)*durationOfNextRecordingGain1 - (int64_t)latestRecordingTime;
+        steps[1].duration = *durationOfNextRecordingGain2;
 
-        if (excessTime > 0) *durationOfNextRecordingGain1 -= excessTime;
+        steps[1].gain = configSettings->gain2;
 
-        if (endOfRecordingPeriod) *endOfRecordingPeriod = *timeOfNextRecordingGain1 + *durationOfNextRecordingGain1;
+        numberOfSteps = 2;
 
     }
 
+    /* The additional steps are found by the schedule so the simulator makes the same sequence */
 
-    if (*timeOfNextRecordingGain2 >= latestRecordingTime) {
-
-        *timeOfNextRecordingGain2 = UINT32_MAX;
-
-        if (startOfRecordingPeriod) *startOfRecordingPeriod = UINT32_MAX;
+    SC_settings_t settings;
 
-        if (endOfRecordingPeriod) *endOfRecordingPeriod = UINT32_MAX;
+    getScheduleSettings(&settings);
 
-        *durationOfNextRecordingGain2 = 0;
+    numberOfSteps += Schedule_getAdditionalRecordings(&settings, timeline, *timeOfNextRecordingGain1, *timeOfNextRecordingGain2, *durationOfNextRecordingGain2, steps + numberOfSteps);
 
-    } else {
-
-        int64_t excessTime = (int64_t)*timeOfNextRecordingGain2 + (int64_t)*durationOfNextRecordingGain2 - (int64_t)latestRecordingTime;
-
-        if (excessTime > 0) *durationOfNextRecordingGain2 -= excessTime;
-
-        if (endOfRecordingPeriod) *endOfRecordingPeriod = *timeOfNextRecordingGain2 + *durationOfNextRecordingGain2;
-
-    }
+    return numberOfSteps;
 
 }
 
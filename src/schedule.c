@@ -0,0 +1,401 @@
+/****************************************************************************
+ * schedule.c
+ * openacousticdevices.info
+ * October 2026
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "schedule.h"
+
+/* Useful time constants */
+
+#define SECONDS_IN_MINUTE                       60
+#define SECONDS_IN_HOUR                         (60 * SECONDS_IN_MINUTE)
+#define SECONDS_IN_DAY                          (24 * SECONDS_IN_HOUR)
+
+#define MINUTES_IN_DAY                          1440
+
+#define START_OF_CENTURY                        946684800
+#define MIDPOINT_OF_CENTURY                     2524608000
+
+/* Useful macros */
+
+#define MIN(a, b)                               ((a) < (b) ? (a) : (b))
+
+#define MAX(a, b)                               ((a) > (b) ? (a) : (b))
+
+/* Schedule recordings */
+
+static void adjustRecordingDuration(uint32_t *duration, uint32_t recordDuration1, uint32_t recordDuration2, uint32_t sleepDuration, uint32_t sleepDurationBetweenGains, uint32_t additionalRecordDuration) {
+    //this cuts the recording period down to not include any final sleep phase
+
+    uint32_t durationOfCycle = recordDuration1 + recordDuration2 + sleepDuration + sleepDurationBetweenGains;
+
+    /* Any additional recording steps after gain2 are taken from the sleep phase */
+
+    uint32_t durationOfRecording = MIN(durationOfCycle, recordDuration1 + sleepDurationBetweenGains + recordDuration2 + additionalRecordDuration);
+
+    uint32_t durationOfSleep = durationOfCycle - durationOfRecording;
+
+    uint32_t numberOfCycles = *duration / durationOfCycle;
+
+    uint32_t partialCycle = *duration % durationOfCycle;
+
+    if (partialCycle == 0) {
+
+        *duration = *duration > durationOfSleep ? *duration - durationOfSleep : 0;
+
+    } else {
+
+        *duration = MIN(*duration, numberOfCycles * durationOfCycle + durationOfRecording);
+
+    }
+
+}
+
+static void addTimelineEvent(SC_settings_t *settings, SC_timeline_t *timeline, SC_recordingPeriod_t *period, int32_t dayOffset, bool isLastEvent) {
+
+    uint32_t duration = period->endMinutes <= period->startMinutes ? MINUTES_IN_DAY + period->endMinutes - period->startMinutes : period->endMinutes - period->startMinutes;
+
+    duration *= SECONDS_IN_MINUTE;
+
+    if (settings->disableSleepRecordCycle == false) {
+
+        adjustRecordingDuration(&duration, settings->recordDurationGain1, settings->recordDurationGain2, settings->sleepDuration, settings->sleepDurationBetweenGains, settings->additionalRecordDuration);
+
+    }
+
+    /* Periods without any recording are skipped, except the first period of the following day which is always the last resort */
+
+    if (duration == 0 && isLastEvent == false) return;
+
+    SC_timelineEvent_t *event = timeline->events + timeline->numberOfEvents;
+
+    event->startOffset = dayOffset + SECONDS_IN_MINUTE * period->startMinutes;
+
+    event->duration = duration;
+
+    event->endOffset = isLastEvent ? INT32_MAX : event->startOffset + (int32_t)duration;
+
+    if (timeline->numberOfEvents > 0) event->endOffset = MAX(event->endOffset, (event - 1)->endOffset);
+
+    timeline->numberOfEvents += 1;
+
+}
+
+/* Set the additional gain steps. Steps with zero duration are not recorded */
+
+void Schedule_setAdditionalGainSteps(SC_settings_t *settings, const SC_gainStep_t *additionalGainSteps, uint32_t numberOfAdditionalGainSteps) {
+
+    settings->additionalGainSteps = additionalGainSteps;
+
+    settings->numberOfAdditionalGainSteps = numberOfAdditionalGainSteps;
+
+    settings->additionalRecordDuration = 0;
+
+    for (uint32_t i = 0; i < numberOfAdditionalGainSteps; i += 1) {
+
+        if (additionalGainSteps[i].duration > 0) settings->additionalRecordDuration += additionalGainSteps[i].sleepDurationBefore + additionalGainSteps[i].duration;
+
+    }
+
+}
+
+void Schedule_compileTimeline(SC_settings_t *settings, SC_timeline_t *timeline) {
+
+    timeline->numberOfEvents = 0;
+
+    uint32_t activeRecordingPeriods = MIN(settings->activeRecordingPeriods, SC_MAX_RECORDING_PERIODS);
+
+    if (activeRecordingPeriods == 0) return;
+
+    /* Last period of the previous day, each period of the day and then the first period of the following day */
+
+    addTimelineEvent(settings, timeline, settings->recordingPeriods + activeRecordingPeriods - 1, -SECONDS_IN_DAY, false);
+
+    for (uint32_t i = 0; i < activeRecordingPeriods; i += 1) {
+
+        addTimelineEvent(settings, timeline, settings->recordingPeriods + i, 0, false);
+
+    }
+
+    addTimelineEvent(settings, timeline, settings->recordingPeriods, SECONDS_IN_DAY, true);
+
+}
+
+static SC_timelineEvent_t* findTimelineEvent(SC_timeline_t *timeline, uint32_t secondsOfDay) {
+
+    /* Find the first period which has not yet ended. The last event always matches */
+
+    uint32_t low = 0;
+
+    uint32_t high = timeline->numberOfEvents - 1;
+
+    while (low < high) {
+
+        uint32_t middle = (low + high) / 2;
+
+        if (timeline->events[middle].endOffset > (int32_t)secondsOfDay) {
+
+            high = middle;
+
+        } else {
+
+            low = middle + 1;
+
+        }
+
+    }
+
+    return timeline->events + low;
+
+}
+
+/* Find the end of the recording period which contains a time */
+
+uint32_t Schedule_getEndOfRecordingPeriod(SC_settings_t *settings, SC_timeline_t *timeline, uint32_t time) {
+
+    if (timeline->numberOfEvents == 0) return 0;
+
+    uint32_t secondsOfDay = time % SECONDS_IN_DAY;
+
+    SC_timelineEvent_t *event = findTimelineEvent(timeline, secondsOfDay);
+
+    uint32_t endOfRecordingPeriod = time - secondsOfDay + event->startOffset + event->duration;
+
+    uint32_t latestRecordingTime = settings->latestRecordingTime > 0 ? settings->latestRecordingTime : MIDPOINT_OF_CENTURY;
+
+    return MIN(endOfRecordingPeriod, latestRecordingTime);
+
+}
+
+/* sets timeOfNextRecording, durationOfNextRecording */
+void Schedule_scheduleRecording(SC_settings_t *settings, SC_timeline_t *timeline, uint32_t currentTime, uint32_t *timeOfNextRecordingGain1, uint32_t *durationOfNextRecordingGain1, uint32_t *timeOfNextRecordingGain2, uint32_t *durationOfNextRecordingGain2, uint32_t *startOfRecordingPeriod, uint32_t *endOfRecordingPeriod) {
+
+    /* Enforce minumum schedule date */
+
+    currentTime = MAX(currentTime, START_OF_CENTURY);
+
+    /* Check if recording should be limited by earliest recording time */
+
+    if (settings->earliestRecordingTime > 0) {
+
+        currentTime = MAX(currentTime, settings->earliestRecordingTime);
+
+    }
+
+    /* No suitable recording periods */
+
+    if (timeline->numberOfEvents == 0) {
+
+        *timeOfNextRecordingGain1 = UINT32_MAX;
+
+        *timeOfNextRecordingGain2 = UINT32_MAX;
+
+        if (startOfRecordingPeriod) *startOfRecordingPeriod = UINT32_MAX;
+
+        if (endOfRecordingPeriod) *endOfRecordingPeriod = UINT32_MAX;
+
+        *durationOfNextRecordingGain1 = 0;
+
+        *durationOfNextRecordingGain2 = 0;
+
+        return;
+
+    }
+
+    /* Look up the current or next recording period in the compiled timeline */
+
+    uint32_t secondsOfDay = currentTime % SECONDS_IN_DAY;
+
+    SC_timelineEvent_t *event = findTimelineEvent(timeline, secondsOfDay);
+
+    uint32_t startTime = currentTime - secondsOfDay + event->startOffset;
+
+    uint32_t duration = event->duration;
+
+    /* Set the time for start and end of the recording period */
+
+    if (startOfRecordingPeriod) *startOfRecordingPeriod = startTime;
+
+    if (endOfRecordingPeriod) *endOfRecordingPeriod = startTime + duration;
+
+    /* Resolve sleep and record cycle */
+
+    if (settings->disableSleepRecordCycle) {
+
+        // if sleep record cycle disabled there will be one long recording at gain1
+        // for the whole recording period
+
+        *timeOfNextRecordingGain1 = startTime;
+
+        *durationOfNextRecordingGain1 = duration;
+
+        *timeOfNextRecordingGain2 = UINT32_MAX;
+
+        *durationOfNextRecordingGain2 = 0;
+
+    } else {
+
+        if (currentTime <= startTime) {
+
+            /* Recording should start at the start of the recording period */
+
+            *timeOfNextRecordingGain1 = startTime;
+
+            *durationOfNextRecordingGain1 = MIN(duration, settings->recordDurationGain1);
+
+            // midnight bug source - fixed
+            if (duration >=  settings->sleepDurationBetweenGains + settings->recordDurationGain1){ //at least some of Gain2 recording fits in period
+
+                *timeOfNextRecordingGain2 = startTime + settings->sleepDurationBetweenGains +settings->recordDurationGain1; //start after recording 1 and sleepBetween
+
+                *durationOfNextRecordingGain2 = MIN(duration - settings->recordDurationGain1 - settings->sleepDurationBetweenGains, settings->recordDurationGain2); //run for full time or rest of period
+            } else {
+
+                *timeOfNextRecordingGain2 = UINT32_MAX; //never (a far future date in 2106)
+
+                *durationOfNextRecordingGain2 = 0;
+
+            }
+
+        } else { //we are currently somewhere in a recording period
+
+            /* Recording should start immediately or at the start of the next recording cycle */
+
+            uint32_t secondsFromStartOfPeriod = currentTime - startTime;
+
+            //figure out what recording/sleep phase were in by looking at current time
+
+            uint32_t durationOfCycle = settings->recordDurationGain1 + settings->sleepDurationBetweenGains + settings->recordDurationGain2 + settings->sleepDuration;
+
+            uint32_t partialCycle = secondsFromStartOfPeriod % durationOfCycle;  //where we are in the recordGain1 - recordGain2 - sleep cycle
+
+            *timeOfNextRecordingGain1 = currentTime - partialCycle;
+
+            *timeOfNextRecordingGain2 = currentTime - partialCycle + settings->recordDurationGain1 + settings->sleepDurationBetweenGains;
+
+            if (partialCycle >= settings->recordDurationGain1) { //we're past first gain recording
+
+                /* Wait for next cycle to begin */
+
+                *timeOfNextRecordingGain1 += durationOfCycle;
+
+                if (partialCycle >= settings->recordDurationGain1 + settings->sleepDurationBetweenGains + settings->recordDurationGain2) { //we're also past second gain recording
+
+                    *timeOfNextRecordingGain2 += durationOfCycle;
+
+                }
+
+            }
+
+            uint32_t remainingDuration = startTime + duration - *timeOfNextRecordingGain1; //of period, for next recording
+
+           *durationOfNextRecordingGain1 = MIN(remainingDuration, settings->recordDurationGain1);
+
+            if (remainingDuration >= settings->recordDurationGain1 + settings->sleepDurationBetweenGains){ //at least some of Gain2 recording fits in period
+
+                *durationOfNextRecordingGain2 = MIN(remainingDuration - settings->recordDurationGain1 - settings->sleepDurationBetweenGains, settings->recordDurationGain2);
+            }
+            else{
+
+                *durationOfNextRecordingGain2 =0;
+            }
+
+
+        }
+
+    }
+
+    /* Check if recording should be limited by last recording time */
+
+    uint32_t latestRecordingTime = settings->latestRecordingTime > 0 ? settings->latestRecordingTime : MIDPOINT_OF_CENTURY;
+
+    if (*timeOfNextRecordingGain1 >= latestRecordingTime) {
+
+        *timeOfNextRecordingGain1 = UINT32_MAX;
+
+        if (startOfRecordingPeriod) *startOfRecordingPeriod = UINT32_MAX;
+
+        if (endOfRecordingPeriod) *endOfRecordingPeriod = UINT32_MAX;
+
+        *durationOfNextRecordingGain1 = 0;
+
+    } else {
+
+        int64_t excessTime = (int64_t)*timeOfNextRecordingGain1 + (int64_t)*durationOfNextRecordingGain1 - (int64_t)latestRecordingTime;
+
+        if (excessTime > 0) *durationOfNextRecordingGain1 -= excessTime;
+
+        if (endOfRecordingPeriod) *endOfRecordingPeriod = *timeOfNextRecordingGain1 + *durationOfNextRecordingGain1;
+
+    }
+
+
+    if (*timeOfNextRecordingGain2 >= latestRecordingTime) {
+
+        *timeOfNextRecordingGain2 = UINT32_MAX;
+
+        if (startOfRecordingPeriod) *startOfRecordingPeriod = UINT32_MAX;
+
+        if (endOfRecordingPeriod) *endOfRecordingPeriod = UINT32_MAX;
+
+        *durationOfNextRecordingGain2 = 0;
+
+    } else {
+
+        int64_t excessTime = (int64_t)*timeOfNextRecordingGain2 + (int64_t)*durationOfNextRecordingGain2 - (int64_t)latestRecordingTime;
+
+        if (excessTime > 0) *durationOfNextRecordingGain2 -= excessTime;
+
+        if (endOfRecordingPeriod) *endOfRecordingPeriod = *timeOfNextRecordingGain2 + *durationOfNextRecordingGain2;
+
+    }
+
+}
+
+/* Find the additional recordings which follow gain2 in one wake-up. They follow a complete gain2 recording and end with the cycle or the recording period */
+
+uint32_t Schedule_getAdditionalRecordings(SC_settings_t *settings, SC_timeline_t *timeline, uint32_t timeOfRecordingGain1, uint32_t timeOfRecordingGain2, uint32_t durationOfRecordingGain2, SC_recordingStep_t *steps) {
+
+    bool completeGain2Recording = timeOfRecordingGain2 >= timeOfRecordingGain1 && durationOfRecordingGain2 == settings->recordDurationGain2;
+
+    if (settings->disableSleepRecordCycle || completeGain2Recording == false) return 0;
+
+    uint32_t durationOfCycle = settings->recordDurationGain1 + settings->sleepDurationBetweenGains + settings->recordDurationGain2 + settings->sleepDuration;
+
+    uint32_t endOfSequence = MIN(timeOfRecordingGain1 + durationOfCycle, Schedule_getEndOfRecordingPeriod(settings, timeline, timeOfRecordingGain1));
+
+    uint32_t timeOfStep = timeOfRecordingGain2 + durationOfRecordingGain2;
+
+    uint32_t numberOfSteps = 0;
+
+    for (uint32_t i = 0; i < settings->numberOfAdditionalGainSteps; i += 1) {
+
+        const SC_gainStep_t *gainStep = settings->additionalGainSteps + i;
+
+        if (gainStep->duration == 0) continue;
+
+        timeOfStep += gainStep->sleepDurationBefore;
+
+        if (timeOfStep >= endOfSequence) break;
+
+        SC_recordingStep_t *step = steps + numberOfSteps;
+
+        step->time = timeOfStep;
+
+        step->duration = MIN(gainStep->duration, endOfSequence - timeOfStep);
+
+        step->gain = gainStep->gain;
+
+        timeOfStep += step->duration;
+
+        numberOfSteps += 1;
+
+    }
+
+    return numberOfSteps;
+
+}